@@ -0,0 +1,134 @@
+// a plain main(), SDL2main's would want argc and argv
+#define SDL_MAIN_HANDLED
+
+#include "particles.h"
+
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <iomanip>
+#include <initializer_list>
+
+#ifdef __unix__
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#elif _WIN32
+#include <ciso646>
+#include <SDL.h>
+#include <SDL_ttf.h>
+#else
+#error Unsupported platform
+#endif
+
+/*
+ * times ParticleSystem::update on full pools
+ * sparks are re-emitted every frame, so the
+ * compaction of dead particles is measured too
+ *
+ * then times a whole frame of them on a headless renderer:
+ * render() queueing one item per spark, and the renderer
+ * sorting, batching and drawing the queue
+ * run it from the game directory, the renderer loads the font
+ */
+
+// one 60 Hz frame
+static const uint64_t delta = 16;
+
+static void timeUpdate()
+{
+	static const int frames = 2000;
+
+	std::cout << std::setw(10) << "particles"
+		  << std::setw(14) << "ms/frame"
+		  << std::setw(14) << "ns/particle"
+		  << std::setw(14) << "% of 60 fps" << '\n';
+
+	for (int capacity : {1024, 4096, 16384, 65536}) {
+		ParticleSystem particles(nullptr, capacity, 0);
+		particles.emit(0, 0, capacity, 90, 0.6, WHITE);
+
+		long long live = 0;
+		auto start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < frames; ++i) {
+			particles.update(delta);
+			live += particles.getCount();
+			particles.emit(0, 0, capacity - particles.getCount(), 90, 0.6, WHITE);
+		}
+
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		double per_frame = elapsed.count() / frames;
+
+		std::cout << std::setw(10) << capacity
+			  << std::setw(14) << std::fixed << std::setprecision(4) << per_frame
+			  << std::setw(14) << std::setprecision(2) << elapsed.count() * 1e6 / live
+			  << std::setw(14) << std::setprecision(3) << per_frame * 100 / (1000.0 / 60) << '\n';
+	}
+}
+
+static void timeRender(int flags, const char *name)
+{
+	static const int frames = 200;
+
+	// the game's native resolution, drawn into an offscreen surface
+	Renderer renderer(flags | RENDER_HEADLESS);
+	renderer.setSize(320, 240);
+
+	std::cout << '\n' << name << '\n'
+		  << std::setw(10) << "particles"
+		  << std::setw(14) << "submit ms"
+		  << std::setw(14) << "draw ms"
+		  << std::setw(14) << "% of 60 fps" << '\n';
+
+	for (int capacity : {1024, 4096, 16384, 65536}) {
+		ParticleSystem particles(&renderer, capacity, 0, true);
+		particles.emit(160, 120, capacity, 90, 0.6, WHITE);
+
+		std::chrono::duration<double, std::milli> submit(0), draw(0);
+
+		for (int i = 0; i < frames; ++i) {
+			particles.update(delta);
+			particles.emit(160, 120, capacity - particles.getCount(), 90, 0.6, WHITE);
+
+			auto start = std::chrono::steady_clock::now();
+			particles.render();
+			auto queued = std::chrono::steady_clock::now();
+			renderer();
+			auto drawn = std::chrono::steady_clock::now();
+
+			submit += queued - start;
+			draw += drawn - queued;
+		}
+
+		double per_frame = (submit.count() + draw.count()) / frames;
+
+		std::cout << std::setw(10) << capacity
+			  << std::setw(14) << std::fixed << std::setprecision(4) << submit.count() / frames
+			  << std::setw(14) << draw.count() / frames
+			  << std::setw(14) << std::setprecision(3) << per_frame * 100 / (1000.0 / 60) << '\n';
+	}
+}
+
+int main()
+{
+	timeUpdate();
+
+	SDL_SetMainReady();
+	SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+
+	if (SDL_Init(SDL_INIT_VIDEO) != 0 or TTF_Init() != 0) {
+		std::cout << "\nno renderer, skipping the frame timings: " << SDL_GetError() << '\n';
+		return 0;
+	}
+
+	try {
+		timeRender(RENDER_DEFAULT, "headless, SDL batches");
+		timeRender(RENDER_SOFTWARE, "headless --software, own blitter");
+	} catch (const std::exception &error) {
+		std::cout << "\nframe timings failed: " << error.what() << '\n';
+	}
+
+	TTF_Quit();
+	SDL_Quit();
+	return 0;
+}
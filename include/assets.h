@@ -0,0 +1,51 @@
+#pragma once
+
+#include "mapped.h"
+#include "packformat.h"
+
+#include <vector>
+#include <string_view>
+#include <filesystem>
+
+#ifdef __unix__
+#include <SDL2/SDL.h>
+#elif _WIN32
+#include <SDL.h>
+#else
+#error Unsupported platform
+#endif
+
+class AssetPack
+{
+	/*
+	 * every game file in one mapped archive
+	 * lookups binary search the table of contents in place
+	 * so opening a packed file costs no syscalls
+	 * files missing from the pack are read from disk
+	 */
+
+private:
+	MappedFile file;
+	const PACK_ENTRY *entries;
+	uint32_t entry_count;
+
+	const PACK_ENTRY *find(std::string_view name);
+
+public:
+	AssetPack(std::filesystem::path path);
+
+	bool isOpen();
+
+	// read only stream over the packed or loose file, nullptr if neither exists
+	SDL_RWops *open(const std::filesystem::path &path);
+
+	/*
+	 * modification time and size identifying a file's contents
+	 * one stat for loose files, none for packed ones
+	 * false if the file does not exist
+	 */
+	bool getStamp(const std::filesystem::path &path, int64_t *mtime, uint64_t *size);
+
+	// ask the kernel to read these files ahead of their use
+	void prefetch(const std::vector<std::filesystem::path> &paths);
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "assets.h"
+#include "mapped.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <filesystem>
+
+#ifdef __unix__
+#include <SDL2/SDL.h>
+#elif _WIN32
+#include <SDL.h>
+#else
+#error Unsupported platform
+#endif
+
+struct CACHE_ENTRY;
+
+class TextureCache
+{
+	/*
+	 * decoded images kept between runs in one mapped file
+	 * entries are keyed by path and checked against the
+	 * source's modification time and size, so edited images
+	 * are decoded again and replace their entry on exit
+	 * entries neither used this run nor matching their
+	 * source any more are dropped then
+	 */
+
+private:
+	std::filesystem::path path;
+	AssetPack *assets;
+	MappedFile *file;
+	const CACHE_ENTRY *entries;
+	uint32_t entry_count;
+	// old entries looked up this run
+	std::vector<bool> used;
+
+	// decoded this run, written out by the destructor
+	struct PENDING {
+		std::string name;
+		int64_t mtime;
+		uint64_t size;
+		int width, height;
+		std::vector<uint8_t> pixels;
+	};
+
+	std::vector<PENDING> pending;
+	std::unordered_map<std::string, size_t> pending_names;
+
+	unsigned long hits;
+	unsigned long misses;
+
+	const CACHE_ENTRY *find(std::string_view name);
+	void save();
+
+public:
+	// empty path disables the cache, assets stamp entries on save
+	TextureCache(std::filesystem::path path, AssetPack *assets);
+	~TextureCache();
+
+	TextureCache(const TextureCache &other) = delete;
+	TextureCache &operator=(const TextureCache &other) = delete;
+
+	/*
+	 * RGBA32 surface over the cached pixels, nullptr if missing or stale
+	 * the pixels are read only and live as long as the cache
+	 */
+	SDL_Surface *load(const std::filesystem::path &path, int64_t mtime, uint64_t size);
+	// remember a freshly decoded RGBA32 surface
+	void store(const std::filesystem::path &path, int64_t mtime, uint64_t size, SDL_Surface *surface);
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+enum CAPTURE_FORMAT {
+	// RGBA32 bytes, one file per frame, size in the name
+	CAPTURE_RAW,
+	// numbered PNG sequence
+	CAPTURE_PNG
+};
+
+class FrameCapture
+{
+	/*
+	 * records frames without touching the disk on the game thread
+	 * frames are read into a ring of reusable buffers
+	 * and a writer thread saves them in order
+	 * when every buffer is still queued the frame is dropped
+	 */
+
+private:
+	struct SLOT {
+		std::vector<uint8_t> pixels;
+		int width, height;
+		uint64_t number;
+		// waiting for the writer
+		bool full;
+	};
+
+	std::filesystem::path directory;
+	CAPTURE_FORMAT format;
+
+	std::vector<SLOT> slots;
+	// next slot the game thread fills, next the writer saves
+	int fill;
+	int write;
+	bool filling;
+
+	std::mutex mutex;
+	std::condition_variable ready;
+	bool stopping;
+	std::thread writer;
+
+	uint64_t frames;
+	uint64_t dropped;
+	// performance counter ticks spent on each side
+	uint64_t capture_ticks;
+	uint64_t fill_start;
+	uint64_t write_ticks;
+	uint64_t written;
+
+	void run();
+	void save(SLOT &slot);
+
+public:
+	FrameCapture(std::filesystem::path directory, CAPTURE_FORMAT format, int buffers = 8);
+	~FrameCapture();
+
+	FrameCapture(const FrameCapture &other) = delete;
+	FrameCapture &operator=(const FrameCapture &other) = delete;
+
+	// RGBA32 buffer for the next frame, nullptr drops it
+	uint8_t *begin(int width, int height);
+	// queue the buffer from begin() for writing
+	void end();
+	// game thread time spent on frames outside begin() and end()
+	void addOverhead(uint64_t ticks);
+
+	// average game thread cost of a captured frame
+	double getOverhead();
+	void report();
+};
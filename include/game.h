@@ -3,6 +3,7 @@
 #include "utilities.h"
 #include "manager.h"
 #include "render.h"
+#include "particles.h"
 
 #include <cstdint>
 #include <vector>
@@ -29,6 +30,41 @@ private:
 	std::vector<std::vector<std::vector<TextureAccess>>> tile;
 	std::vector<std::vector<bool>> collision;
 
+	/*
+	 * static tile layers pre-rendered in CHUNK_SIZE blocks
+	 * chunk[level] holds the same map downsampled by 1 << level
+	 * for zoomed out views
+	 */
+	std::vector<std::vector<std::vector<std::vector<TextureAccess>>>> chunk;
+	unsigned long chunk_generation;
+
+	/*
+	 * animated tiles, every cell of one animation
+	 * shows the same view texture
+	 * which is switched to the current frame once per tick
+	 */
+	struct ANIMATION {
+		std::filesystem::path path;
+		std::vector<TextureAccess> frames;
+		uint64_t frame_time;
+		size_t current;
+		TextureAccess view;
+	};
+
+	struct CELL {
+		int x, y;
+		int layer;
+	};
+
+	std::vector<ANIMATION> animations;
+	uint64_t animation_tick;
+	// animated cells sorted into the chunks they are drawn with
+	std::vector<std::vector<std::vector<CELL>>> animated;
+
+	// averaged tile colours, minimap_scale pixels per tile
+	TextureAccess minimap;
+	int minimap_scale;
+
 public:
 	MapManager(GameManager *parent);
 
@@ -38,11 +74,23 @@ public:
 	bool getCollision(int pos_x, int pos_y);
 
 	void getSize(int *x, int *y);
+	TextureAccess getMinimap();
+	int getMinimapScale();
 
+	void runTick(uint64_t delta);
 	void render();
 
 private:
 	void resizeMapStorage(int x, int y, bool absolute = false);
+	// both return the hash that keys the minimap cache
+	uint64_t loadTextMap(std::filesystem::path map_path, bool respawn);
+	bool loadCompiledMap(std::filesystem::path path, bool respawn, uint64_t *hash);
+	TextureAccess loadAnimation(std::filesystem::path path);
+	bool isAnimated(int pos_x, int pos_y, int layer);
+	bool isOpaque(int pos_x, int pos_y, int layer);
+	void bakeChunks();
+	void bakeLevel(int level);
+	void buildMinimap(uint64_t hash);
 };
 
 class GameObject
@@ -88,6 +136,7 @@ public:
 	void setScreenPos(int x, int y, bool anim = true);
 	void getScreenPos(int *x, int *y);
 	void getCenter(int *x, int *y);
+	int getBottom();
 
 	bool isCameraCenter();
 
@@ -217,17 +266,25 @@ private:
 	Renderer *renderer;
 	MapManager map_manager;
 	QuizManager quiz_manager;
+	ParticleSystem particles;
 
 	std::list<GameObject *> objects;
+	// objects by bottom edge, kept between frames
+	std::vector<GameObject *> draw_order;
 	std::vector<std::vector<GameObject *>> collision;
 
 	uint64_t playtime;
 
 	bool paused;
+	// one viewport per camera instead of averaging them
+	bool split_screen;
+	std::vector<SDL_Point> cameras;
 
 	int collectibles;
 	int collected;
 	std::list<std::string> hints;
+	// bumped by every addHint, the list itself keeps only one
+	unsigned long hint_count;
 
 public:
 	GameManager(Manager *parent);
@@ -237,6 +294,7 @@ public:
 	Renderer *getRenderer();
 	MapManager *getMapManager();
 	QuizManager *getQuizManager();
+	ParticleSystem *getParticles();
 	Player *getPlayer();
 
 	void loadObject(std::filesystem::path object_path, int map_x, int map_y);
@@ -256,7 +314,8 @@ public:
 	void addCollectible();
 	void useCollectible();
 	void addHint(std::string hint);
-	std::list<std::string> getHints();
+	const std::list<std::string> &getHints();
+	unsigned long getHintCount();
 
 	void runTick(uint64_t delta);
 };
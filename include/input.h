@@ -13,6 +13,8 @@ private:
 	bool pause;
 	bool enter;
 	std::vector<bool> answer;
+	bool render_reset;
+	bool device_reset;
 
 public:
 	InputHandler();
@@ -24,4 +26,6 @@ public:
 	bool isPause(bool clear = false);
 	bool isEnter(bool clear = false);
 	bool isAnswer(int ans, bool clear = false);
+	bool isRenderReset(bool clear = false);
+	bool isDeviceReset(bool clear = false);
 };
@@ -5,6 +5,8 @@
 #include "game.h"
 #include "ui.h"
 
+#include <string>
+
 class GameManager;
 class UIManager;
 
@@ -31,6 +33,10 @@ public:
 	GameManager *getGameManager();
 	UIManager *getUIManager();
 
+	bool hasOption(const std::string &option);
+	// value following option, false if missing
+	bool getOption(const std::string &option, std::string *value);
+
 	void quit();
 
 	int operator()();
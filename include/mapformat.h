@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * compiled map, written by ooq_mapc and mapped by MapManager
+ * native little endian, offsets count from the start of the file
+ *
+ * MAP_HEADER
+ * MAP_DIRECTORY[directory_count]          every distinct directory, with its trailing slash
+ * MAP_ENTRY[entry_count]                  every distinct path, as directory and file name
+ * char[]                                  directories, then file names, not terminated
+ * uint16_t[MAP_LAYERS][width][height]     entry + 1 per tile, 0 if empty
+ * uint8_t[(width * height + 7) / 8]       collision bits, x * height + y
+ *                                         set when solid, as are cells without tiles
+ * MAP_OBJECT[object_count]                objects in map file order
+ */
+
+// "OOQM" read as a little endian word
+#define MAP_MAGIC 0x4d514f4f
+#define MAP_VERSION 3
+#define MAP_LAYERS 2
+#define MAP_EXTENSION ".map"
+
+enum MAP_KIND {MAP_KIND_TILE, MAP_KIND_ANIMATION, MAP_KIND_OBJECT};
+
+struct MAP_HEADER {
+	uint32_t magic;
+	uint32_t version;
+	// hash of the text map, keys the minimap cache
+	uint64_t source_hash;
+	int32_t width, height;
+	int32_t spawn_x, spawn_y;
+	uint32_t directory_count, directory_offset;
+	uint32_t entry_count, entry_offset;
+	uint32_t layer_offset;
+	uint32_t collision_offset;
+	uint32_t object_count, object_offset;
+};
+
+struct MAP_DIRECTORY {
+	uint32_t path_offset;
+	uint16_t path_size;
+	uint16_t padding;
+};
+
+// path is the directory's followed by name
+struct MAP_ENTRY {
+	uint32_t name_offset;
+	uint16_t directory;
+	uint8_t name_size;
+	// MAP_KIND
+	uint8_t kind;
+};
+
+struct MAP_OBJECT {
+	int32_t x, y;
+	uint32_t entry;
+};
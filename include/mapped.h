@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+
+class MappedFile
+{
+	/*
+	 * read only view of a whole file
+	 * pages are faulted in on first touch
+	 * instead of being read up front
+	 */
+
+private:
+	const uint8_t *data;
+	size_t size;
+
+#if _WIN32
+	// HANDLEs, kept opaque so windows.h stays out of headers
+	void *file;
+	void *mapping;
+#endif
+
+public:
+	// closed on failure, check isOpen
+	MappedFile(std::filesystem::path path);
+	~MappedFile();
+
+	MappedFile(const MappedFile &other) = delete;
+	MappedFile &operator=(const MappedFile &other) = delete;
+
+	bool isOpen();
+	const uint8_t *getData();
+	size_t getSize();
+
+	// hint that a range is needed soon
+	void prefetch(size_t offset, size_t size);
+};
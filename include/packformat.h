@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * asset pack, written by ooq_pack and mapped by AssetPack
+ * native little endian, offsets count from the start of the file
+ *
+ * PACK_HEADER
+ * PACK_ENTRY[entry_count]    sorted by name, byte wise
+ * char[]                     names, generic paths like data/ui/point.png
+ * file contents, in entry order so one directory is one range
+ */
+
+// "OOQP" read as a little endian word
+#define PACK_MAGIC 0x50514f4f
+#define PACK_VERSION 2
+#define PACK_FILE "assets.pack"
+// file contents start on this boundary
+#define PACK_ALIGNMENT 16
+
+struct PACK_HEADER {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entry_count;
+	uint32_t entry_offset;
+};
+
+struct PACK_ENTRY {
+	uint32_t name_offset;
+	uint32_t name_size;
+	uint64_t offset;
+	uint64_t size;
+	// of the source file, as std::filesystem counts it, so caches outlive a repack
+	int64_t mtime;
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "render.h"
+
+#include <vector>
+#include <cstdint>
+
+class ParticleSystem
+{
+	/*
+	 * fixed pool of short lived sparks
+	 * every field lives in its own array so the update
+	 * walks them four particles at a time
+	 * live particles are packed at the front, dead ones
+	 * are replaced by the last live one
+	 */
+
+private:
+	Renderer *renderer;
+	TextureAccess spark;
+
+	int layer;
+	bool overlay;
+
+	int capacity;
+	int count;
+
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> vx;
+	std::vector<float> vy;
+	// seconds left and seconds at birth, for fading
+	std::vector<float> life;
+	std::vector<float> lifetime;
+	std::vector<uint8_t> color;
+
+public:
+	// renderer may be nullptr when only simulating
+	ParticleSystem(Renderer *renderer, int capacity, int layer, bool overlay = false);
+
+	// spray count sparks from x, y, dropped once the pool is full
+	void emit(int x, int y, int count, float speed, float lifetime, COLOR color);
+	void clear();
+
+	int getCount();
+	int getCapacity();
+
+	void update(uint64_t delta);
+	void render();
+};
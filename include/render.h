@@ -1,10 +1,18 @@
 #pragma once
 
 #include <list>
-#include <queue>
+#include <vector>
 #include <string>
 #include <functional>
+#include <cstdint>
 #include <filesystem>
+#include <unordered_map>
+#include <utility>
+
+#include "software.h"
+#include "capture.h"
+#include "assets.h"
+#include "cache.h"
 
 #ifdef __unix__
 #include <SDL2/SDL.h>
@@ -17,9 +25,29 @@
 #endif
 
 #define MAX_TILE_LAYER 5
+// largest atlas page, clamped to what the renderer supports
+#define ATLAS_SIZE 2048
+// pages start this small and double while they fill up
+#define ATLAS_MIN_SIZE 256
 
 enum COLOR {BLACK, GRAY, WHITE, RED, GREEN, BLUE};
 
+// how much of an image is covered, only known for atlas regions
+enum ALPHA {ALPHA_EMPTY, ALPHA_OPAQUE, ALPHA_MIXED};
+
+// renderer options, combined as flags
+enum RENDER_FLAGS {
+	RENDER_DEFAULT = 0,
+	// draw at native size, then upscale the whole frame once
+	RENDER_INTEGER_SCALE = 1 << 0,
+	// compose frames on the cpu, for machines without a gpu
+	RENDER_SOFTWARE = 1 << 1,
+	// no window and no vsync, frames land in an offscreen surface
+	RENDER_HEADLESS = 1 << 2
+};
+
+SDL_Color getColor(COLOR color);
+
 class Renderer;
 
 class Texture
@@ -31,24 +59,72 @@ private:
 	int height;
 	long usage;
 	bool keep;
+	// atlas page, filled through the shadow
+	bool page;
+
+	// region of texture covered by this object
+	SDL_Rect source;
+	// atlas page this region lives in, nullptr if texture is owned
+	Texture *atlas;
+	/*
+	 * cpu side copy of an atlas page, uploaded by TextureManager
+	 * dropped once a finished page is on the gpu
+	 * images made at runtime keep one to restore themselves
+	 */
+	SDL_Surface *shadow;
+	bool dirty;
+	// pixels for the software renderer, shared with the page for regions
+	Bitmap *bitmap;
+	// kept here too, software images have no SDL_Texture to hold it
+	SDL_BlendMode blend_mode;
+
+	ALPHA alpha;
+	// pixel hash of atlas regions, 0 otherwise
+	uint64_t hash;
+	// alpha weighted mean of atlas regions, gray otherwise
+	SDL_Color average;
+
+	void replace(Texture &other, std::list<Texture> &textures);
 
 public:
 
 	Texture(Renderer *renderer, std::filesystem::path path, bool keep = false);
-	Texture(Renderer *renderer, std::string text, COLOR color = BLACK, bool keep = false);
+	Texture(Renderer *renderer, SDL_Surface *surface);
+	Texture(Renderer *renderer, int width, int height, SDL_TextureAccess access);
+	Texture(Texture *atlas, SDL_Rect source, std::filesystem::path path, ALPHA alpha = ALPHA_MIXED, uint64_t hash = 0, SDL_Color average = {169, 169, 169, 255});
 	~Texture();
 
+	void update(SDL_Surface *surface, SDL_Rect rect);
+	bool matches(SDL_Surface *surface);
+	SDL_Color getAverageColor();
+	void show(Texture *frame);
+	bool upload();
+	void grow(Renderer *renderer, int size, std::list<Texture> &textures);
+	void dropShadow();
+	bool hasShadow();
+	void restore(Renderer *renderer, std::list<Texture> &textures);
+
+	// shared by all regions of a page, like the SDL_Texture's
+	void setBlendMode(SDL_BlendMode mode);
+	SDL_BlendMode getBlendMode();
+
 	SDL_Texture *getTexture();
+	Bitmap *getBitmap();
+	const SDL_Rect *getSource();
 	std::filesystem::path getPath();
 
 	int getWidth();
 	int getHeight();
+	void getTextureSize(int *width, int *height);
 
 	long addUsage();
 	long remUsage();
 	long getUsage();
 
 	bool isKeep();
+	ALPHA getAlpha();
+	Texture *getAtlas();
+	uint64_t getHash();
 
 	bool operator==(const Texture &other) const;
 };
@@ -63,7 +139,7 @@ public:
 	TextureAccess(const TextureAccess &other);
 	~TextureAccess();
 
-	Texture *operator()();
+	Texture *operator()() const;
 	TextureAccess &operator=(const TextureAccess &other);
 	bool operator==(const TextureAccess &other) const;
 };
@@ -73,49 +149,151 @@ class TextureManager
 private:
 	Renderer *parent;
 	std::list<Texture> textures;
+	std::unordered_map<std::string, Texture *> paths;
+	std::vector<Texture *> pending;
+	// atlas regions by pixel hash, for sharing identical images
+	std::unordered_map<uint64_t, Texture *> hashes;
+
+	// shelf packer state for an atlas page being filled
+	struct PAGE {
+		Texture *texture;
+		int x, y;
+		int shelf_height;
+	};
+
+	// largest a page may grow to
+	int atlas_size;
+	// map tiles and other packed images
+	PAGE atlas;
+	// glyphs only, never closed so text does not pin a map's page
+	PAGE glyphs;
 
 public:
 	TextureManager(Renderer *parent);
+	~TextureManager();
+
+	TextureManager(const TextureManager &other) = delete;
+	TextureManager &operator=(const TextureManager &other) = delete;
 
 	TextureAccess getMissingTexture();
-	TextureAccess loadTexture(std::filesystem::path path);
-	TextureAccess makeText(std::string text, COLOR color = BLACK);
+	TextureAccess loadTexture(std::filesystem::path path, bool pack = false);
+	TextureAccess makeTarget(int width, int height);
+	TextureAccess makeFrame(int width, int height);
+	TextureAccess makeImage(SDL_Surface *surface);
+	TextureAccess packSurface(SDL_Surface *surface);
+	TextureAccess packGlyph(SDL_Surface *surface);
+	TextureAccess makeView(const TextureAccess &frame);
+	TextureAccess makeRegion(const TextureAccess &texture, SDL_Rect source);
+
+	void closeAtlas();
+	void updateAtlas();
 	void cleanup();
+	void restore();
+
+private:
+	Texture *packTexture(SDL_Surface *surface, std::filesystem::path path, PAGE &page);
+	void closePage(PAGE &page);
 };
 
 class RenderItem
 {
+	/*
+	 * plain data, copied around by value
+	 * the texture is not kept alive by the item,
+	 * TextureManager only frees unused textures after the frame is drawn
+	 */
+
 private:
-	TextureAccess texture;
+	Texture *texture;
 	int pos_x;
 	int pos_y;
-	bool flip_vert;
-	bool flip_horz;
-	int layer;
-	bool overlay;
+	short layer;
+	bool flip_vert : 1;
+	bool flip_horz : 1;
+	bool overlay : 1;
+	// covers texture size << lod map pixels
+	unsigned char lod : 2;
+	// modulates the texture, white leaves it untouched
+	COLOR color : 8;
+	// 255 draws the texture as is
+	uint8_t opacity;
 
 public:
-	RenderItem(TextureAccess texture, int pos_x, int pos_y, bool flip_vert, bool flip_horz, int layer, bool overlay = false);
+	RenderItem(const TextureAccess &texture, int pos_x, int pos_y, bool flip_vert, bool flip_horz, int layer, bool overlay = false, COLOR color = WHITE);
 
 	/* are these setters really necessary?
 	void setTexture(TextureAccess texture);
+	*/
 	void setX(int pos_x);
 	void setY(int pos_y);
 	void setLayer(int layer);
-	*/
+	void setLod(int lod);
+	void setOpacity(int opacity);
 
-	TextureAccess getTexture() const;
+	Texture *getTexture() const;
+	const SDL_Rect *getSource() const;
 	int getX() const;
 	int getY() const;
 	bool getFlipVert() const;
 	bool getFlipHorz() const;
 	int getLayer() const;
 	bool getOverlay() const;
+	int getLod() const;
+	COLOR getColor() const;
+	int getOpacity() const;
+};
+
+class RenderQueue
+{
+	/*
+	 * render items bucketed by layer
+	 * items keep submission order inside a layer
+	 * and bucket storage is reused between frames
+	 */
+
+private:
+	std::vector<std::vector<RenderItem>> layers;
+	// layers whose items never overlap and may be grouped by texture
+	std::vector<bool> batching;
+
+public:
+	RenderQueue();
+
+	void push(const RenderItem &item);
+	void setBatching(int layer, bool batching);
+
+	int getLayerCount() const;
+	const std::vector<RenderItem> &getLayer(int layer) const;
+
+	void sort();
+	void clear();
+};
+
+class GlyphAtlas
+{
+	/*
+	 * every glyph is rasterised once in white
+	 * and packed into the glyph page of TextureManager
+	 * text is then drawn as colour modulated glyph quads
+	 */
+
+private:
+	struct GLYPH {
+		TextureAccess texture;
+		int advance;
+	};
+
+	Renderer *parent;
+	TextureManager *texture_manager;
+	std::unordered_map<uint32_t, GLYPH> glyphs;
+
+public:
+	GlyphAtlas(Renderer *parent);
+
+	int addText(const std::string &text, int pos_x, int pos_y, int layer, COLOR color, bool overlay, std::vector<RenderItem> *items = nullptr);
 
-	auto operator<=>(const RenderItem &other) const;
-	// defined by compiler since C++20
-	//bool operator<(const RenderItem &other) const;
-	//bool operator>(const RenderItem &other) const;
+private:
+	GLYPH &getGlyph(uint32_t codepoint);
 };
 
 class Renderer
@@ -123,25 +301,103 @@ class Renderer
 private:
 	SDL_Window *window;
 	SDL_Renderer *renderer;
+	// what the renderer draws into when headless, nullptr otherwise
+	SDL_Surface *offscreen;
+	// every file the renderer loads goes through here
+	AssetPack *assets;
+	// decoded images from earlier runs
+	TextureCache *texture_cache;
 	TextureManager *texture_manager;
 	TTF_Font *font;
-	int center_x, center_y;
-	std::priority_queue<RenderItem, std::vector<RenderItem>, std::greater<RenderItem>>
-	                render_queue;
+	GlyphAtlas *glyph_atlas;
+	int flags;
+	int width, height;
+	// native resolution frame for RENDER_INTEGER_SCALE, RENDER_SOFTWARE and capture
+	TextureAccess frame;
+	// records every presented frame when set
+	FrameCapture *capture;
+	// copy of the last frame, read back for capture one frame later
+	TextureAccess readback;
+	bool readback_ready;
+	// where draws currently land, nullptr for the window
+	Texture *target;
+	// software renderer clip rectangle
+	SDL_Rect clip;
+	bool clipped;
+
+	// one per camera, side by side on screen
+	struct VIEWPORT {
+		SDL_Rect rect;
+		int center_x, center_y;
+		// map pixels are shrunk by 1 << zoom
+		int zoom;
+	};
+
+	std::vector<VIEWPORT> viewports;
+
+	RenderQueue render_queue;
+	// bumped whenever render target contents are lost
+	unsigned long target_generation;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	// SDL_RenderGeometry batch of items sharing a texture
+	bool geometry = true;
+	SDL_Texture *batch_texture = nullptr;
+	std::vector<SDL_Vertex> vertices;
+	std::vector<int> indices;
+	std::vector<std::pair<RenderItem, SDL_Rect>> batch_items;
+#endif
 
 public:
-	Renderer();
+	Renderer(int flags = RENDER_DEFAULT);
 	~Renderer();
 
 	SDL_Renderer *getRenderer();
 	TextureManager *getTextureManager();
+	AssetPack *getAssets();
+	TextureCache *getTextureCache();
 	TTF_Font *getFont();
+	bool isSoftware();
+	bool isHeadless();
+
+	// call before setSize so frames are captured at native size
+	void startCapture(std::filesystem::path directory, CAPTURE_FORMAT format);
 
 	void setSize(int width, int height);
-	void setCenter(int x, int y);
+	void getSize(int *width, int *height);
+	void setCenter(int x, int y, int viewport = 0);
+	void setLayerBatching(int layer, bool batching);
+
+	void setViewportCount(int count);
+	int getViewportCount();
+	void setZoom(int zoom, int viewport = 0);
+	int getZoom(int viewport = 0);
+	void getView(int *x, int *y, int *w, int *h, int viewport = 0);
+	bool isVisible(int x, int y, int w, int h);
 
 	void addRenderItem(const RenderItem &item);
-	void addRenderItem(TextureAccess texture, int pos_x, int pos_y, bool flip_vert, bool flip_horz, int layer, bool overlay = false);
+	void addRenderItem(const TextureAccess &texture, int pos_x, int pos_y, bool flip_vert, bool flip_horz, int layer, bool overlay = false, COLOR color = WHITE);
+	void addRenderItems(const std::vector<RenderItem> &items, int offset_x, int offset_y, int layer);
+	int addText(const std::string &text, int pos_x, int pos_y, int layer, COLOR color = BLACK, bool overlay = true);
+	int layoutText(const std::string &text, int pos_x, int pos_y, COLOR color, std::vector<RenderItem> &items);
+
+	void renderToTexture(TextureAccess target, const std::vector<RenderItem> &items, SDL_BlendMode blend_mode = SDL_BLENDMODE_BLEND, int zoom = 0, bool clear = true);
+	void restoreTextures();
+	void invalidateTargets();
+	unsigned long getTargetGeneration();
 
 	void operator()();
+
+private:
+	SDL_Rect place(const RenderItem &item, int offset_x, int offset_y, int zoom);
+	void batch(const RenderItem &item, int offset_x, int offset_y, int zoom = 0);
+	void flush();
+	void draw(const RenderItem &item, const SDL_Rect &pos);
+	void grab();
+	void readBack();
+	void present();
+	void layoutViewports();
+	void setTarget(Texture *target);
+	void setClip(const SDL_Rect *rect);
+	void clear();
 };
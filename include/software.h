@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+
+#ifdef __unix__
+#include <SDL2/SDL.h>
+#elif _WIN32
+#include <SDL.h>
+#else
+#error Unsupported platform
+#endif
+
+// how source pixels are combined with the destination
+enum BLIT {
+	// straight copy, alpha included
+	BLIT_COPY,
+	// source over destination, like SDL_BLENDMODE_BLEND
+	BLIT_BLEND
+};
+
+class Bitmap
+{
+	/*
+	 * RGBA32 pixels for the software renderer
+	 * every row starts on a 32 byte boundary
+	 * so one AVX2 register holds 8 whole pixels
+	 */
+
+private:
+	uint8_t *memory;
+	uint32_t *pixels;
+	int width, height;
+	// row stride in pixels
+	int pitch;
+
+public:
+	Bitmap(int width, int height);
+	Bitmap(SDL_Surface *surface);
+	~Bitmap();
+
+	Bitmap(const Bitmap &other) = delete;
+	Bitmap &operator=(const Bitmap &other) = delete;
+
+	void clear();
+
+	uint32_t *getPixels();
+	uint32_t *getRow(int y);
+	int getWidth();
+	int getHeight();
+	int getPitch();
+};
+
+/*
+ * copy source out of src to pos in dst, limited to clip
+ * same size copies go through the SIMD row kernels
+ * scaled or modulated ones fall back to per pixel code
+ */
+void blit(Bitmap *dst, const SDL_Rect *clip, Bitmap *src, const SDL_Rect *source, const SDL_Rect *pos, SDL_RendererFlip flip, BLIT mode, SDL_Color color);
@@ -3,14 +3,114 @@
 #include "manager.h"
 #include "render.h"
 #include "game.h"
+#include "particles.h"
 
 #include <list>
 #include <vector>
 #include <string>
+#include <filesystem>
 
 class Manager;
 class GameManager;
 
+class TextBlock
+{
+	/*
+	 * word wrapped text laid out once
+	 * and only again when string, width or colour change
+	 * use ; to force newline
+	 */
+
+private:
+	// spacing between lines
+	static const int SPACING = 12;
+
+	Renderer *renderer;
+	std::string text;
+	int max_char;
+	COLOR color;
+	bool valid;
+
+	std::vector<RenderItem> items;
+	int height;
+
+public:
+	TextBlock(Renderer *renderer = nullptr);
+
+	void set(const std::string &text, int max_char, COLOR color = BLACK);
+	int render(int x, int y, int layer);
+	int render(int x, int y, std::vector<RenderItem> &items);
+};
+
+class Panel
+{
+	/*
+	 * screen sized ui composed into a render target
+	 * composed again only after invalidate()
+	 * or when the target lost its contents
+	 */
+
+private:
+	Renderer *renderer;
+	TextureAccess target;
+	bool dirty;
+	unsigned long generation;
+
+public:
+	Panel(Renderer *renderer = nullptr);
+
+	// call whenever anything the panel shows changes
+	void invalidate();
+	bool isStale();
+	void compose(const TextureAccess &background, const std::vector<RenderItem> &items);
+	void render(int layer);
+};
+
+class Transition
+{
+	/*
+	 * opening animation of a full screen panel
+	 * described by transition.txt in its folder:
+	 *   panel <file>                                  final frame
+	 *   tween <ms> <from x> <from y> <from opacity>   slide and fade in
+	 *   sheet <file> <columns> <frames> <ms>          frames of one image
+	 * folders without it, or with a bad sheet line,
+	 * list numbered frames in max_frame.txt
+	 * nothing is loaded until the panel is first opened
+	 */
+
+private:
+	// numbered frames advance this often
+	static const uint64_t FRAMETIME = 100;
+
+	Renderer *renderer;
+	std::filesystem::path path;
+	bool loaded;
+
+	TextureAccess panel;
+	std::vector<TextureAccess> frames;
+	uint64_t frame_time;
+
+	uint64_t duration;
+	int from_x, from_y;
+	int from_opacity;
+
+	// how far open, 0 to duration
+	uint64_t time;
+
+public:
+	Transition(Renderer *renderer = nullptr, std::filesystem::path path = "");
+
+	void update(bool open, uint64_t delta);
+	bool isOpen();
+	void render(int layer);
+	TextureAccess getPanel();
+
+private:
+	void load();
+	void loadNumbered();
+};
+
 class UIManager
 {
 private:
@@ -20,31 +120,50 @@ private:
 	InputHandler *input_handler;
 	GameManager *game_manager;
 
-	const uint64_t FRAMETIME = 100;
 	uint64_t tick;
 	uint64_t splash_deadline;
 
 	bool in_menu;
-	uint64_t menu_deadline;
-	unsigned int menu_counter;
-
 	bool in_quiz;
-	uint64_t quiz_deadline;
-	unsigned int quiz_counter;
 
 	std::string question;
 	std::vector<std::string> answers;
 
+	TextBlock question_text;
+	std::vector<TextBlock> answer_text;
+	std::vector<TextBlock> hint_text;
+
+	Panel menu_panel;
+	Panel quiz_panel;
+	// scratch list for composing panels
+	std::vector<RenderItem> panel_items;
+
+	// game values the menu panel was last composed with
+	struct MENU_STATE {
+		uint64_t hours, minutes;
+		int remaining;
+		unsigned long hints;
+		int player_x, player_y;
+		Texture *minimap;
+
+		bool operator==(const MENU_STATE &other) const = default;
+	};
+
+	MENU_STATE menu_state;
+
 	TextureAccess splash;
-	std::vector<TextureAccess> menu;
-	std::vector<TextureAccess> quiz;
+	Transition menu;
+	Transition quiz;
+	// answer feedback, above every panel
+	ParticleSystem effects;
 
 	TextureAccess continue_btn;
 	TextureAccess documentation_btn;
 	TextureAccess exit_btn;
 	TextureAccess submit_btn;
 
-	TextureAccess minimap;
+	// part of the map's minimap shown on the menu
+	TextureAccess minimap_view;
 	TextureAccess point;
 
 public:
@@ -52,10 +171,11 @@ public:
 
 	void displayQuiz(std::string question, std::vector<std::string> answers);
 	void endQuiz();
+	// burst over the submit button, green if right
+	void showResult(bool correct);
 
 	void operator()(uint64_t delta);
 
 private:
-	int printText(std::string text, int x, int y, int max_char, int layer, COLOR color = BLACK);
 	void openDocumentation();
 };
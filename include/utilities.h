@@ -8,9 +8,12 @@
  */
 
 #include <stdint.h>
+#include <stddef.h>
 
 enum DIR {UP = 0, LEFT, DOWN, RIGHT, DIR_SIZE};
 
 int sgn(int nr);
 int countDigit(int n);
 void getTime(uint64_t time, uint64_t *hours, uint64_t *minutes, uint64_t *seconds);
+// FNV-1a, pass the previous result to continue a hash
+uint64_t hashBytes(const void *data, size_t size, uint64_t hash = 0xcbf29ce484222325);
@@ -0,0 +1,154 @@
+#include "assets.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#if _WIN32
+#include <ciso646>
+#endif
+
+// separate reads closer than this are prefetched as one range
+#define PREFETCH_GAP (64 * 1024)
+
+AssetPack::AssetPack(std::filesystem::path path) :
+	file(path),
+	entries(nullptr),
+	entry_count(0)
+{
+	const uint8_t *data = file.getData();
+	size_t size = file.getSize();
+
+	PACK_HEADER header;
+
+	if (not file.isOpen() or size < sizeof(header))
+		return;
+
+	std::memcpy(&header, data, sizeof(header));
+
+	if (header.magic != PACK_MAGIC or header.version != PACK_VERSION or
+	    header.entry_offset > size or
+	    header.entry_count > (size - header.entry_offset) / sizeof(PACK_ENTRY)) {
+		SDL_Log("ignoring %s, it is damaged or from another version", path.string().c_str());
+		return;
+	}
+
+	auto *table = reinterpret_cast<const PACK_ENTRY *>(data + header.entry_offset);
+
+	// names are compared on every lookup, so they must all be in range
+	for (uint32_t i = 0; i < header.entry_count; ++i)
+		if (table[i].name_offset > size or table[i].name_size > size - table[i].name_offset) {
+			SDL_Log("ignoring %s, its table of contents is damaged", path.string().c_str());
+			return;
+		}
+
+	entries = table;
+	entry_count = header.entry_count;
+
+	SDL_Log("using asset pack %s: %u files", path.string().c_str(), entry_count);
+}
+
+bool AssetPack::isOpen()
+{
+	return entries;
+}
+
+const PACK_ENTRY *AssetPack::find(std::string_view name)
+{
+	const char *base = reinterpret_cast<const char *>(file.getData());
+	size_t size = file.getSize();
+
+	auto getName = [base](const PACK_ENTRY &entry) {
+		return std::string_view(base + entry.name_offset, entry.name_size);
+	};
+
+	const PACK_ENTRY *found = std::lower_bound(
+		entries, entries + entry_count, name,
+		[&getName](const PACK_ENTRY &entry, std::string_view name) {
+			return getName(entry) < name;
+		}
+	);
+
+	if (found == entries + entry_count or getName(*found) != name)
+		return nullptr;
+
+	// never hand out bytes past the end of a truncated pack
+	if (found->offset > size or found->size > size - found->offset)
+		return nullptr;
+
+	return found;
+}
+
+SDL_RWops *AssetPack::open(const std::filesystem::path &path)
+{
+	if (path.empty())
+		return nullptr;
+
+	if (entries) {
+		const PACK_ENTRY *entry = find(path.generic_string());
+
+		if (entry)
+			return SDL_RWFromConstMem(file.getData() + entry->offset, entry->size);
+	}
+
+	// loose file, nullptr when it does not exist
+	return SDL_RWFromFile(path.string().c_str(), "rb");
+}
+
+bool AssetPack::getStamp(const std::filesystem::path &path, int64_t *mtime, uint64_t *size)
+{
+	if (path.empty())
+		return false;
+
+	if (entries) {
+		const PACK_ENTRY *entry = find(path.generic_string());
+
+		if (entry) {
+			*mtime = entry->mtime;
+			*size = entry->size;
+			return true;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::directory_entry file(path, error);
+
+	if (error or not file.is_regular_file(error))
+		return false;
+
+	*size = file.file_size(error);
+	*mtime = file.last_write_time(error).time_since_epoch().count();
+
+	return not error;
+}
+
+void AssetPack::prefetch(const std::vector<std::filesystem::path> &paths)
+{
+	if (not entries)
+		return;
+
+	std::vector<std::pair<uint64_t, uint64_t>> ranges;
+
+	for (auto &path : paths) {
+		const PACK_ENTRY *entry = find(path.generic_string());
+
+		if (entry)
+			ranges.emplace_back(entry->offset, entry->offset + entry->size);
+	}
+
+	std::sort(ranges.begin(), ranges.end());
+
+	/*
+	 * files of one map sit next to each other in the pack
+	 * so the merged ranges are few and large
+	 */
+	for (size_t i = 0; i < ranges.size();) {
+		uint64_t start = ranges[i].first;
+		uint64_t end = ranges[i].second;
+
+		for (++i; i < ranges.size() and ranges[i].first <= end + PREFETCH_GAP; ++i)
+			end = std::max(end, ranges[i].second);
+
+		file.prefetch(start, end - start);
+	}
+}
@@ -0,0 +1,293 @@
+#include "cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#if _WIN32
+#include <ciso646>
+#endif
+
+/*
+ * file layout, native little endian
+ *
+ * CACHE_HEADER
+ * CACHE_ENTRY[entry_count]    sorted by name, byte wise
+ * char[]                      names
+ * RGBA32 pixels, width * 4 bytes per row, CACHE_ALIGNMENT aligned
+ */
+
+// "OOQT" read as a little endian word
+#define CACHE_MAGIC 0x54514f4f
+#define CACHE_VERSION 1
+#define CACHE_ALIGNMENT 16
+
+struct CACHE_HEADER {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entry_count;
+	uint32_t entry_offset;
+};
+
+struct CACHE_ENTRY {
+	uint32_t name_offset;
+	uint32_t name_size;
+	int64_t mtime;
+	uint64_t size;
+	int32_t width, height;
+	uint64_t pixels_offset;
+};
+
+TextureCache::TextureCache(std::filesystem::path path, AssetPack *assets) :
+	path(path),
+	assets(assets),
+	file(nullptr),
+	entries(nullptr),
+	entry_count(0),
+	hits(0),
+	misses(0)
+{
+	if (path.empty())
+		return;
+
+	file = new MappedFile(path);
+
+	const uint8_t *data = file->getData();
+	size_t size = file->getSize();
+
+	CACHE_HEADER header;
+
+	if (not file->isOpen() or size < sizeof(header))
+		return;
+
+	std::memcpy(&header, data, sizeof(header));
+
+	if (header.magic != CACHE_MAGIC or header.version != CACHE_VERSION or
+	    header.entry_offset > size or
+	    header.entry_count > (size - header.entry_offset) / sizeof(CACHE_ENTRY))
+		return;
+
+	auto *table = reinterpret_cast<const CACHE_ENTRY *>(data + header.entry_offset);
+
+	// a damaged cache is ignored and rewritten
+	for (uint32_t i = 0; i < header.entry_count; ++i) {
+		uint64_t bytes = static_cast<uint64_t>(table[i].width) * table[i].height * 4;
+
+		if (table[i].name_offset > size or table[i].name_size > size - table[i].name_offset or
+		    table[i].width <= 0 or table[i].height <= 0 or
+		    table[i].pixels_offset > size or bytes > size - table[i].pixels_offset)
+			return;
+	}
+
+	entries = table;
+	entry_count = header.entry_count;
+	used.assign(entry_count, false);
+}
+
+TextureCache::~TextureCache()
+{
+	if (not pending.empty())
+		save();
+
+	if (hits or misses)
+		SDL_Log("texture cache: %lu hits, %lu decoded", hits, misses);
+
+	delete file;
+}
+
+const CACHE_ENTRY *TextureCache::find(std::string_view name)
+{
+	const char *base = reinterpret_cast<const char *>(file->getData());
+
+	auto getName = [base](const CACHE_ENTRY &entry) {
+		return std::string_view(base + entry.name_offset, entry.name_size);
+	};
+
+	const CACHE_ENTRY *found = std::lower_bound(
+		entries, entries + entry_count, name,
+		[&getName](const CACHE_ENTRY &entry, std::string_view name) {
+			return getName(entry) < name;
+		}
+	);
+
+	if (found == entries + entry_count or getName(*found) != name)
+		return nullptr;
+
+	return found;
+}
+
+SDL_Surface *TextureCache::load(const std::filesystem::path &path, int64_t mtime, uint64_t size)
+{
+	const CACHE_ENTRY *entry = entries ? find(path.generic_string()) : nullptr;
+
+	if (entry)
+		used[entry - entries] = true;
+
+	// stale entries are replaced once the image is decoded again
+	if (not entry or entry->mtime != mtime or entry->size != size) {
+		++misses;
+		return nullptr;
+	}
+
+	SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormatFrom(
+		const_cast<uint8_t *>(file->getData() + entry->pixels_offset),
+		entry->width, entry->height, 32, entry->width * 4,
+		SDL_PIXELFORMAT_RGBA32
+	);
+
+	if (surface)
+		++hits;
+
+	return surface;
+}
+
+void TextureCache::store(const std::filesystem::path &path, int64_t mtime, uint64_t size, SDL_Surface *surface)
+{
+	if (this->path.empty() or surface->format->format != SDL_PIXELFORMAT_RGBA32)
+		return;
+
+	std::string name = path.generic_string();
+	auto found = pending_names.find(name);
+
+	// images unloaded and loaded again are stored once
+	if (found == pending_names.end()) {
+		pending_names[name] = pending.size();
+		pending.emplace_back();
+		found = pending_names.find(name);
+	}
+
+	PENDING &entry = pending[found->second];
+	entry.name = name;
+	entry.mtime = mtime;
+	entry.size = size;
+	entry.width = surface->w;
+	entry.height = surface->h;
+	entry.pixels.resize(surface->w * surface->h * 4);
+
+	SDL_LockSurface(surface);
+
+	for (int y = 0; y < surface->h; ++y)
+		std::memcpy(
+			entry.pixels.data() + y * surface->w * 4,
+			static_cast<uint8_t *>(surface->pixels) + y * surface->pitch,
+			surface->w * 4
+		);
+
+	SDL_UnlockSurface(surface);
+}
+
+void TextureCache::save()
+{
+	/*
+	 * merge surviving old entries with this run's
+	 * into a new file, then swap it in
+	 * an old entry survives when it was used this run
+	 * or its source is still there and unchanged
+	 */
+	struct SOURCE {
+		std::string_view name;
+		const CACHE_ENTRY *old;
+		const PENDING *fresh;
+	};
+
+	std::vector<SOURCE> sources;
+	const char *base = file and entries ? reinterpret_cast<const char *>(file->getData()) : nullptr;
+
+	for (uint32_t i = 0; i < entry_count; ++i) {
+		std::string_view name(base + entries[i].name_offset, entries[i].name_size);
+
+		if (pending_names.count(std::string(name)))
+			continue;
+
+		int64_t mtime;
+		uint64_t size;
+
+		if (not used[i] and not (
+			assets->getStamp(std::filesystem::path(name), &mtime, &size) and
+			mtime == entries[i].mtime and size == entries[i].size
+		))
+			continue;
+
+		sources.push_back({name, &entries[i], nullptr});
+	}
+
+	for (auto &fresh : pending)
+		sources.push_back({fresh.name, nullptr, &fresh});
+
+	std::sort(sources.begin(), sources.end(), [](const SOURCE &a, const SOURCE &b) {
+		return a.name < b.name;
+	});
+
+	CACHE_HEADER header;
+	header.magic = CACHE_MAGIC;
+	header.version = CACHE_VERSION;
+	header.entry_count = sources.size();
+	header.entry_offset = sizeof(header);
+
+	std::vector<CACHE_ENTRY> table(sources.size());
+	uint64_t offset = header.entry_offset + table.size() * sizeof(CACHE_ENTRY);
+
+	for (size_t i = 0; i < sources.size(); ++i) {
+		table[i].name_offset = offset;
+		table[i].name_size = sources[i].name.size();
+		offset += sources[i].name.size();
+	}
+
+	for (size_t i = 0; i < sources.size(); ++i) {
+		if (sources[i].old) {
+			table[i].mtime = sources[i].old->mtime;
+			table[i].size = sources[i].old->size;
+			table[i].width = sources[i].old->width;
+			table[i].height = sources[i].old->height;
+		} else {
+			table[i].mtime = sources[i].fresh->mtime;
+			table[i].size = sources[i].fresh->size;
+			table[i].width = sources[i].fresh->width;
+			table[i].height = sources[i].fresh->height;
+		}
+
+		offset = (offset + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+		table[i].pixels_offset = offset;
+		offset += static_cast<uint64_t>(table[i].width) * table[i].height * 4;
+	}
+
+	std::filesystem::path temporary = path;
+	temporary += ".tmp";
+
+	{
+		std::ofstream out(temporary, std::ios::binary);
+
+		out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(CACHE_ENTRY));
+
+		for (auto &source : sources)
+			out.write(source.name.data(), source.name.size());
+
+		for (size_t i = 0; i < sources.size(); ++i) {
+			static const char zeros[CACHE_ALIGNMENT] = {};
+			out.write(zeros, table[i].pixels_offset - out.tellp());
+
+			if (sources[i].old)
+				out.write(base + sources[i].old->pixels_offset, static_cast<uint64_t>(table[i].width) * table[i].height * 4);
+			else
+				out.write(reinterpret_cast<const char *>(sources[i].fresh->pixels.data()), sources[i].fresh->pixels.size());
+		}
+
+		if (not out) {
+			SDL_Log("could not write texture cache %s", temporary.string().c_str());
+			return;
+		}
+	}
+
+	// the old file has to be unmapped before it can be replaced
+	delete file;
+	file = nullptr;
+	entries = nullptr;
+	entry_count = 0;
+
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+
+	if (error)
+		SDL_Log("could not replace texture cache %s: %s", path.string().c_str(), error.message().c_str());
+}
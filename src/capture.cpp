@@ -0,0 +1,195 @@
+#include "capture.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+#ifdef __unix__
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#elif _WIN32
+#include <ciso646>
+#include <SDL.h>
+#include <SDL_image.h>
+#else
+#error Unsupported platform
+#endif
+
+FrameCapture::FrameCapture(std::filesystem::path directory, CAPTURE_FORMAT format, int buffers) :
+	directory(directory),
+	format(format),
+	slots(buffers),
+	fill(0),
+	write(0),
+	filling(false),
+	stopping(false),
+	frames(0),
+	dropped(0),
+	capture_ticks(0),
+	fill_start(0),
+	write_ticks(0),
+	written(0)
+{
+	std::filesystem::create_directories(directory);
+
+	for (auto &slot : slots)
+		slot.full = false;
+
+	writer = std::thread(&FrameCapture::run, this);
+}
+
+FrameCapture::~FrameCapture()
+{
+	// let the writer drain what is queued
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	ready.notify_one();
+	writer.join();
+
+	report();
+}
+
+uint8_t *FrameCapture::begin(int width, int height)
+{
+	fill_start = SDL_GetPerformanceCounter();
+
+	SLOT &slot = slots[fill];
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (slot.full) {
+			// writer is behind, never wait for it
+			++dropped;
+			return nullptr;
+		}
+	}
+
+	// buffers only grow, so steady capture does not allocate
+	slot.pixels.resize(width * height * 4);
+	slot.width = width;
+	slot.height = height;
+	slot.number = frames + dropped;
+	filling = true;
+
+	return slot.pixels.data();
+}
+
+void FrameCapture::end()
+{
+	if (not filling)
+		return;
+
+	filling = false;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		slots[fill].full = true;
+	}
+
+	ready.notify_one();
+	fill = (fill + 1) % slots.size();
+
+	++frames;
+	capture_ticks += SDL_GetPerformanceCounter() - fill_start;
+}
+
+void FrameCapture::addOverhead(uint64_t ticks)
+{
+	capture_ticks += ticks;
+}
+
+void FrameCapture::run()
+{
+	for (;;) {
+		SLOT *slot;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			ready.wait(lock, [this]() {
+				return slots[write].full or stopping;
+			});
+
+			if (not slots[write].full)
+				return;
+
+			slot = &slots[write];
+		}
+
+		// the game thread leaves full slots alone
+		uint64_t start = SDL_GetPerformanceCounter();
+		save(*slot);
+		uint64_t ticks = SDL_GetPerformanceCounter() - start;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			slot->full = false;
+			write_ticks += ticks;
+			++written;
+		}
+
+		write = (write + 1) % slots.size();
+	}
+}
+
+void FrameCapture::save(SLOT &slot)
+{
+	std::ostringstream name;
+	name << std::setw(6) << std::setfill('0') << slot.number;
+
+	if (format == CAPTURE_RAW) {
+		name << '_' << slot.width << 'x' << slot.height << ".rgba";
+
+		std::ofstream file(directory / name.str(), std::ios::binary);
+		file.write(reinterpret_cast<const char *>(slot.pixels.data()), slot.pixels.size());
+
+		if (not file)
+			SDL_Log("capture: could not write %s", name.str().c_str());
+
+		return;
+	}
+
+	name << ".png";
+
+	SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormatFrom(
+		slot.pixels.data(), slot.width, slot.height,
+		32, slot.width * 4, SDL_PIXELFORMAT_RGBA32
+	);
+
+	if (not surface or IMG_SavePNG(surface, (directory / name.str()).string().c_str()))
+		SDL_Log("capture: could not write %s: %s", name.str().c_str(), SDL_GetError());
+
+	SDL_FreeSurface(surface);
+}
+
+double FrameCapture::getOverhead()
+{
+	if (not frames)
+		return 0;
+
+	return static_cast<double>(capture_ticks) / frames / SDL_GetPerformanceFrequency() * 1000;
+}
+
+void FrameCapture::report()
+{
+	uint64_t saved, ticks;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		saved = written;
+		ticks = write_ticks;
+	}
+
+	double write_ms = saved ? static_cast<double>(ticks) / saved / SDL_GetPerformanceFrequency() * 1000 : 0;
+
+	SDL_Log(
+		"capture: %llu frames, %llu dropped, %.3f ms per frame on the game thread, %.3f ms per frame writing",
+		static_cast<unsigned long long>(frames),
+		static_cast<unsigned long long>(dropped),
+		getOverhead(), write_ms
+	);
+}
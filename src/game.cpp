@@ -1,6 +1,8 @@
 #include "game.h"
 
 #include "config.h"
+#include "mapped.h"
+#include "mapformat.h"
 
 #include <algorithm>
 #include <limits>
@@ -8,6 +10,14 @@
 #include <utility>
 #include <random>
 #include <fstream>
+#include <set>
+#include <tuple>
+#include <iterator>
+#include <sstream>
+#include <iomanip>
+#include <unordered_map>
+#include <stdexcept>
+#include <cstring>
 
 #if _WIN32
 #include <ciso646>
@@ -16,8 +26,15 @@
 MapManager::MapManager(GameManager *parent) :
 	parent(parent),
 	renderer(parent->getRenderer()),
-	texture_manager(renderer->getTextureManager())
+	texture_manager(renderer->getTextureManager()),
+	chunk_generation(0),
+	animation_tick(0),
+	minimap_scale(1)
 {
+	// tile layers never overlap themselves
+	renderer->setLayerBatching(0, true);
+	renderer->setLayerBatching(2, true);
+
 	// load available maps
 	std::ifstream maps_file("data/maps.txt");
 
@@ -38,13 +55,61 @@ void MapManager::loadMap(int map, bool respawn)
 	//if (map == current_map)
 	//	return;
 
-	std::ifstream data(maps[map]);
-
 	// update current map
 	current_map = map;
 
 	// clear old data
 	resizeMapStorage(-1, -1, true);
+	animations.clear();
+
+	// pack this map's tiles into atlas pages of its own
+	texture_manager->closeAtlas();
+
+	// prefer the compiled map, the text one still works without it
+	uint64_t hash;
+
+	if (not loadCompiledMap(maps[map], respawn, &hash))
+		hash = loadTextMap(maps[map], respawn);
+
+	// report how much of the map is actually distinct
+	int tiles = 0;
+	std::set<std::tuple<Texture *, int, int>> unique;
+	std::set<Texture *> pages;
+
+	for (auto &column : tile)
+		for (auto &cell : column)
+			for (auto &layer : cell)
+				if (layer()) {
+					// software pages have no SDL_Texture to count
+					Texture *page = layer()->getAtlas() ? layer()->getAtlas() : layer();
+
+					++tiles;
+					unique.emplace(
+						page,
+						layer()->getSource()->x,
+						layer()->getSource()->y
+					);
+					pages.insert(page);
+				}
+
+	SDL_Log(
+		"loaded map %s: %d tiles, %zu unique images on %zu textures",
+		maps[map].string().c_str(), tiles, unique.size(), pages.size()
+	);
+
+	bakeChunks();
+	buildMinimap(hash);
+}
+
+uint64_t MapManager::loadTextMap(std::filesystem::path map_path, bool respawn)
+{
+	// whole file at once, it also keys the minimap cache
+	std::ifstream file(map_path, std::ios::binary);
+	std::string content(
+		(std::istreambuf_iterator<char>(file)),
+		std::istreambuf_iterator<char>()
+	);
+	std::istringstream data(content);
 
 	// read default spawn coords
 	data >> spawn_x >> spawn_y;
@@ -62,11 +127,23 @@ void MapManager::loadMap(int map, bool respawn)
 
 		if (path.extension() == ".png") {
 			// load tile
-			bool coll;
-			int layer;
+			// some maps use other non zero values for solid
+			int coll, layer;
 			data >> coll >> layer;
 
-			tile[pos_x][pos_y][layer] = texture_manager->loadTexture(path);
+			TextureAccess texture = texture_manager->loadTexture(path, true);
+
+			// fully transparent tiles are never drawn
+			if (texture()->getAlpha() != ALPHA_EMPTY)
+				tile[pos_x][pos_y][layer] = texture;
+
+			collision[pos_x][pos_y] = coll;
+		} else if (path.extension() == ".anim") {
+			// load animated tile
+			int coll, layer;
+			data >> coll >> layer;
+
+			tile[pos_x][pos_y][layer] = loadAnimation(path);
 			collision[pos_x][pos_y] = coll;
 		} else if (path.extension() == ".txt") {
 			// load object
@@ -75,6 +152,143 @@ void MapManager::loadMap(int map, bool respawn)
 			parent->loadObject(path, pos_x, pos_y);
 		}
 	}
+
+	return hashBytes(content.data(), content.size());
+}
+
+bool MapManager::loadCompiledMap(std::filesystem::path path, bool respawn, uint64_t *hash)
+{
+	/*
+	 * binary map written by ooq_mapc into the build tree, see mapformat.h
+	 * read in place from the mapping, so only touched pages are loaded
+	 * and every distinct path is resolved once
+	 */
+	std::filesystem::path compiled = std::filesystem::path(OOQ_BUILD_DIR) / path;
+	compiled.replace_extension(MAP_EXTENSION);
+
+	std::error_code error;
+	auto compiled_time = std::filesystem::last_write_time(compiled, error);
+
+	if (error)
+		return false;
+
+	auto source_time = std::filesystem::last_write_time(path, error);
+
+	if (not error and source_time > compiled_time) {
+		SDL_Log("%s is older than its source, rebuild the maps target", compiled.string().c_str());
+		return false;
+	}
+
+	MappedFile file(compiled);
+	const uint8_t *data = file.getData();
+	size_t size = file.getSize();
+
+	MAP_HEADER header;
+
+	if (not file.isOpen() or size < sizeof(header))
+		return false;
+
+	std::memcpy(&header, data, sizeof(header));
+
+	if (header.magic != MAP_MAGIC or header.version != MAP_VERSION or
+	    header.width < 0 or header.height < 0)
+		return false;
+
+	size_t cells = static_cast<size_t>(header.width) * header.height;
+
+	// reject truncated files instead of reading past the end
+	auto fits = [size](size_t offset, size_t bytes) {
+		return offset <= size and bytes <= size - offset;
+	};
+
+	if (not fits(header.directory_offset, header.directory_count * sizeof(MAP_DIRECTORY)) or
+	    not fits(header.entry_offset, header.entry_count * sizeof(MAP_ENTRY)) or
+	    not fits(header.layer_offset, MAP_LAYERS * cells * sizeof(uint16_t)) or
+	    not fits(header.collision_offset, (cells + 7) / 8) or
+	    not fits(header.object_offset, header.object_count * sizeof(MAP_OBJECT))) {
+		SDL_Log("%s is damaged, falling back to the text map", compiled.string().c_str());
+		return false;
+	}
+
+	auto *directories = reinterpret_cast<const MAP_DIRECTORY *>(data + header.directory_offset);
+	auto *entries = reinterpret_cast<const MAP_ENTRY *>(data + header.entry_offset);
+	auto *ids = reinterpret_cast<const uint16_t *>(data + header.layer_offset);
+	auto *solid = data + header.collision_offset;
+	auto *objects = reinterpret_cast<const MAP_OBJECT *>(data + header.object_offset);
+
+	std::vector<std::filesystem::path> paths(header.entry_count);
+
+	for (uint32_t i = 0; i < header.entry_count; ++i) {
+		if (entries[i].directory >= header.directory_count)
+			continue;
+
+		const MAP_DIRECTORY &directory = directories[entries[i].directory];
+
+		if (not fits(directory.path_offset, directory.path_size) or
+		    not fits(entries[i].name_offset, entries[i].name_size))
+			continue;
+
+		// same string as the text map line
+		std::string joined(reinterpret_cast<const char *>(data + directory.path_offset), directory.path_size);
+		joined.append(reinterpret_cast<const char *>(data + entries[i].name_offset), entries[i].name_size);
+		paths[i] = joined;
+	}
+
+	// have the kernel read this map's part of the asset pack in one go
+	renderer->getAssets()->prefetch(paths);
+
+	spawn_x = header.spawn_x;
+	spawn_y = header.spawn_y;
+
+	if (respawn)
+		parent->getPlayer()->setMapPos(spawn_x, spawn_y, false);
+
+	resizeMapStorage(header.width - 1, header.height - 1);
+
+	// one texture per entry, not per cell
+	std::vector<TextureAccess> textures(header.entry_count);
+
+	for (uint32_t i = 0; i < header.entry_count; ++i)
+		switch (entries[i].kind) {
+		case MAP_KIND_TILE:
+			textures[i] = texture_manager->loadTexture(paths[i], true);
+
+			// fully transparent tiles are never drawn
+			if (textures[i]()->getAlpha() == ALPHA_EMPTY)
+				textures[i] = TextureAccess();
+
+			break;
+
+		case MAP_KIND_ANIMATION:
+			textures[i] = loadAnimation(paths[i]);
+			break;
+
+		default:
+			// objects are loaded after the tiles
+			break;
+		}
+
+	for (int layer = 0; layer < MAP_LAYERS; ++layer)
+		for (int x = 0; x < header.width; ++x)
+			for (int y = 0; y < header.height; ++y) {
+				uint16_t id = ids[layer * cells + x * header.height + y];
+
+				if (id and id <= header.entry_count)
+					tile[x][y][layer] = textures[id - 1];
+			}
+
+	for (int x = 0; x < header.width; ++x)
+		for (int y = 0; y < header.height; ++y) {
+			size_t cell = static_cast<size_t>(x) * header.height + y;
+			collision[x][y] = solid[cell / 8] & (1 << (cell % 8));
+		}
+
+	for (uint32_t i = 0; i < header.object_count; ++i)
+		if (objects[i].entry < header.entry_count)
+			parent->loadObject(paths[objects[i].entry], objects[i].x, objects[i].y);
+
+	*hash = header.source_hash;
+	return true;
 }
 
 void MapManager::getSpawn(int *x, int *y)
@@ -102,16 +316,93 @@ void MapManager::getSize(int *x, int *y)
 		*y = 0;
 }
 
-void MapManager::render()
+TextureAccess MapManager::getMinimap()
 {
-	for (int i = 0; i < tile.size(); ++i)
-		for (int j = 0; j < tile[i].size(); ++j) {
-			if (tile[i][j][0] != texture_manager->getMissingTexture())
-				renderer->addRenderItem(tile[i][j][0], i * TILE_SIZE, j * TILE_SIZE, false, false, 0);
+	return minimap;
+}
 
-			if (tile[i][j][1] != texture_manager->getMissingTexture())
-				renderer->addRenderItem(tile[i][j][1], i * TILE_SIZE, j * TILE_SIZE, false, false, 2);
+int MapManager::getMinimapScale()
+{
+	return minimap_scale;
+}
+
+void MapManager::runTick(uint64_t delta)
+{
+	// one shared clock, cost grows with animations and not cells
+	animation_tick += delta;
+
+	for (auto &animation : animations) {
+		size_t frame = animation_tick / animation.frame_time % animation.frames.size();
+
+		if (frame != animation.current) {
+			animation.current = frame;
+			animation.view()->show(animation.frames[frame]());
 		}
+	}
+}
+
+void MapManager::render()
+{
+	// chunks lost their contents, draw them again
+	if (chunk_generation != renderer->getTargetGeneration())
+		bakeChunks();
+
+	// only submit chunks a camera can see
+	static const int CHUNK_PIXELS = CHUNK_SIZE * TILE_SIZE;
+	int viewport_count = renderer->getViewportCount();
+	std::vector<SDL_Rect> ranges(viewport_count);
+	std::vector<int> levels(viewport_count);
+
+	for (int v = 0; v < viewport_count; ++v) {
+		int view_x, view_y, view_w, view_h;
+		renderer->getView(&view_x, &view_y, &view_w, &view_h, v);
+
+		// zoomed out views use the matching downsampled chunks
+		int level = std::min(renderer->getZoom(v), CHUNK_LEVELS - 1);
+		int level_pixels = CHUNK_PIXELS << level;
+		auto &chunks = chunk[level];
+
+		int begin_x = std::max(view_x, 0) / level_pixels;
+		int begin_y = std::max(view_y, 0) / level_pixels;
+		int end_x = (view_x + view_w + level_pixels - 1) / level_pixels;
+		int end_y = (view_y + view_h + level_pixels - 1) / level_pixels;
+
+		end_x = std::min<int>(end_x, chunks.size());
+		ranges[v] = {begin_x, begin_y, end_x - begin_x, end_y - begin_y};
+		levels[v] = level;
+
+		for (int i = begin_x; i < end_x; ++i)
+			for (int j = begin_y; j < std::min<int>(end_y, chunks[i].size()); ++j) {
+				// chunks shared with an earlier viewport are already queued
+				SDL_Point point = {i, j};
+				bool queued = false;
+
+				for (int u = 0; u < v; ++u)
+					if (levels[u] == level and SDL_PointInRect(&point, &ranges[u]))
+						queued = true;
+
+				if (queued)
+					continue;
+
+				// layer 1 is reserved for game objects
+				for (int layer = 0; layer < 2; ++layer) {
+					RenderItem item(chunks[i][j][layer], i * level_pixels, j * level_pixels, false, false, layer * 2);
+					item.setLod(level);
+					renderer->addRenderItem(item);
+				}
+
+				// baked into the lower levels
+				if (level > 0)
+					continue;
+
+				for (auto &cell : animated[i][j])
+					renderer->addRenderItem(
+						tile[cell.x][cell.y][cell.layer],
+						cell.x * TILE_SIZE, cell.y * TILE_SIZE,
+						false, false, cell.layer * 2
+					);
+			}
+	}
 }
 
 void MapManager::resizeMapStorage(int x, int y, bool absolute)
@@ -145,6 +436,318 @@ void MapManager::resizeMapStorage(int x, int y, bool absolute)
 	}
 }
 
+TextureAccess MapManager::loadAnimation(std::filesystem::path path)
+{
+	/*
+	 * animation files hold the time per frame in ms
+	 * followed by the path of every frame
+	 */
+	for (auto &animation : animations)
+		if (animation.path == path)
+			return animation.view;
+
+	ANIMATION animation;
+	animation.path = path;
+	animation.frame_time = 0;
+	animation.current = 0;
+
+	std::ifstream file(path);
+	std::filesystem::path frame;
+
+	file >> animation.frame_time;
+
+	while (file >> frame)
+		animation.frames.push_back(texture_manager->loadTexture(frame, true));
+
+	if (animation.frames.empty())
+		animation.frames.push_back(texture_manager->getMissingTexture());
+
+	if (animation.frame_time == 0)
+		animation.frame_time = 1;
+
+	animation.view = texture_manager->makeView(animation.frames[0]);
+	animations.push_back(animation);
+
+	return animations.back().view;
+}
+
+bool MapManager::isAnimated(int pos_x, int pos_y, int layer)
+{
+	// few animations per map, a linear search is enough
+	for (auto &animation : animations)
+		if (tile[pos_x][pos_y][layer] == animation.view)
+			return true;
+
+	return false;
+}
+
+bool MapManager::isOpaque(int pos_x, int pos_y, int layer)
+{
+	Texture *texture = tile[pos_x][pos_y][layer]();
+
+	return texture and texture->getAlpha() == ALPHA_OPAQUE;
+}
+
+void MapManager::bakeChunks()
+{
+	/*
+	 * tiles never change after loading
+	 * so draw each layer of each chunk once
+	 * and only blit the results every frame
+	 */
+	static const int CHUNK_PIXELS = CHUNK_SIZE * TILE_SIZE;
+
+	int size_x, size_y;
+	getSize(&size_x, &size_y);
+
+	int chunks_x = (size_x + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	int chunks_y = (size_y + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+	// make sure freshly packed tiles are on the gpu
+	texture_manager->updateAtlas();
+
+	chunk.clear();
+	chunk.resize(CHUNK_LEVELS);
+	chunk[0].resize(chunks_x);
+	animated.clear();
+	animated.resize(chunks_x, std::vector<std::vector<CELL>>(chunks_y));
+
+	std::vector<RenderItem> items;
+
+	for (int i = 0; i < chunks_x; ++i) {
+		chunk[0][i].resize(chunks_y);
+
+		for (int j = 0; j < chunks_y; ++j) {
+			chunk[0][i][j].resize(2);
+
+			for (int layer = 0; layer < 2; ++layer) {
+				items.clear();
+
+				// a chunk covering whole cells can skip blending
+				bool opaque = (i + 1) * CHUNK_SIZE <= size_x and
+					      (j + 1) * CHUNK_SIZE <= size_y;
+
+				for (int x = i * CHUNK_SIZE; x < std::min(size_x, (i + 1) * CHUNK_SIZE); ++x)
+					for (int y = j * CHUNK_SIZE; y < std::min(size_y, (j + 1) * CHUNK_SIZE); ++y) {
+						bool covered = isOpaque(x, y, layer);
+
+						/*
+						 * lower tiles under an opaque upper tile are culled
+						 * the hole is painted over by the upper chunk anyway
+						 */
+						if (layer == 0 and isOpaque(x, y, 1))
+							covered = true;
+						else if (isAnimated(x, y, layer))
+							// drawn on its own every frame
+							animated[i][j].push_back({x, y, layer});
+						else if (tile[x][y][layer]())
+							items.emplace_back(
+								tile[x][y][layer],
+								(x - i * CHUNK_SIZE) * TILE_SIZE,
+								(y - j * CHUNK_SIZE) * TILE_SIZE,
+								false, false, layer, true
+							);
+
+						opaque = opaque and covered;
+					}
+
+				// leave empty chunks out entirely
+				if (items.empty())
+					continue;
+
+				chunk[0][i][j][layer] = texture_manager->makeTarget(CHUNK_PIXELS, CHUNK_PIXELS);
+
+				// tiles of one layer never overlap, copy them as is
+				renderer->renderToTexture(chunk[0][i][j][layer], items, SDL_BLENDMODE_NONE);
+
+				if (opaque)
+					chunk[0][i][j][layer]()->setBlendMode(SDL_BLENDMODE_NONE);
+			}
+		}
+	}
+
+	for (int level = 1; level < CHUNK_LEVELS; ++level)
+		bakeLevel(level);
+
+	chunk_generation = renderer->getTargetGeneration();
+}
+
+void MapManager::bakeLevel(int level)
+{
+	/*
+	 * every chunk of a level is its four children
+	 * drawn at half size, so the number of chunks
+	 * on screen stays the same however far out we zoom
+	 */
+	static const int CHUNK_PIXELS = CHUNK_SIZE * TILE_SIZE;
+	auto &children = chunk[level - 1];
+
+	int chunks_x = (children.size() + 1) / 2;
+	int chunks_y = children.empty() ? 0 : (children[0].size() + 1) / 2;
+
+#if SDL_VERSION_ATLEAST(2, 0, 12)
+	// halving with linear filtering averages each 2x2 block
+	for (auto &column : children)
+		for (auto &cell : column)
+			for (auto &texture : cell)
+				if (texture() and texture()->getTexture())
+					SDL_SetTextureScaleMode(texture()->getTexture(), SDL_ScaleModeLinear);
+#endif
+
+	chunk[level].assign(chunks_x, std::vector<std::vector<TextureAccess>>(chunks_y, std::vector<TextureAccess>(2)));
+
+	std::vector<RenderItem> items;
+
+	for (int i = 0; i < chunks_x; ++i)
+		for (int j = 0; j < chunks_y; ++j)
+			for (int layer = 0; layer < 2; ++layer) {
+				items.clear();
+
+				int covered = 0;
+
+				for (int x = 2 * i; x < std::min<int>(2 * i + 2, children.size()); ++x)
+					for (int y = 2 * j; y < std::min<int>(2 * j + 2, children[x].size()); ++y) {
+						TextureAccess &child = children[x][y][layer];
+
+						if (child()) {
+							items.emplace_back(
+								child,
+								(x - 2 * i) * (CHUNK_PIXELS << (level - 1)),
+								(y - 2 * j) * (CHUNK_PIXELS << (level - 1)),
+								false, false, layer, true
+							);
+							items.back().setLod(level - 1);
+
+							if (child()->getBlendMode() == SDL_BLENDMODE_NONE)
+								++covered;
+						}
+
+						// too small to notice, freeze animations at their current frame
+						if (level == 1)
+							for (auto &cell : animated[x][y])
+								if (cell.layer == layer)
+									items.emplace_back(
+										tile[cell.x][cell.y][layer],
+										cell.x * TILE_SIZE - i * (CHUNK_PIXELS << level),
+										cell.y * TILE_SIZE - j * (CHUNK_PIXELS << level),
+										false, false, layer, true
+									);
+					}
+
+				if (items.empty())
+					continue;
+
+				chunk[level][i][j][layer] = texture_manager->makeTarget(CHUNK_PIXELS, CHUNK_PIXELS);
+				renderer->renderToTexture(chunk[level][i][j][layer], items, SDL_BLENDMODE_NONE, level);
+
+				if (covered == 4)
+					chunk[level][i][j][layer]()->setBlendMode(SDL_BLENDMODE_NONE);
+			}
+
+#if SDL_VERSION_ATLEAST(2, 0, 12)
+	// back to crisp pixels when drawn 1:1
+	for (auto &column : children)
+		for (auto &cell : column)
+			for (auto &texture : cell)
+				if (texture() and texture()->getTexture())
+					SDL_SetTextureScaleMode(texture()->getTexture(), SDL_ScaleModeNearest);
+#endif
+}
+
+void MapManager::buildMinimap(uint64_t hash)
+{
+	/*
+	 * one block of averaged tile colour per cell
+	 * cached on disk by map and tile content
+	 * so only new or edited maps pay for building it
+	 */
+	int size_x, size_y;
+	getSize(&size_x, &size_y);
+
+	// about the size of the menu page, never below a pixel per tile
+	static const int MINIMAP_PIXELS = 512;
+	minimap_scale = std::max(1, MINIMAP_PIXELS / std::max({size_x, size_y, 1}));
+
+	for (auto &column : tile)
+		for (auto &cell : column)
+			for (auto &layer : cell)
+				if (layer()) {
+					uint64_t tile_hash = layer()->getHash();
+					hash = hashBytes(&tile_hash, sizeof(tile_hash), hash);
+				}
+
+	hash = hashBytes(&minimap_scale, sizeof(minimap_scale), hash);
+
+	std::filesystem::path cache;
+	char *pref = SDL_GetPrefPath("", "OOQ");
+
+	if (pref) {
+		std::ostringstream name;
+		name << "minimap_" << std::hex << std::setw(16) << std::setfill('0') << hash << ".bmp";
+
+		cache = std::filesystem::path(pref) / name.str();
+		SDL_free(pref);
+	}
+
+	SDL_Surface *surface = nullptr;
+
+	if (not cache.empty() and std::filesystem::exists(cache))
+		surface = SDL_LoadBMP(cache.string().c_str());
+
+	if (not surface) {
+		surface = SDL_CreateRGBSurfaceWithFormat(
+				0,
+				std::max(size_x, 1) * minimap_scale,
+				std::max(size_y, 1) * minimap_scale,
+				32,
+				SDL_PIXELFORMAT_RGBA32
+			);
+
+		if (!surface)
+			throw std::runtime_error(SDL_GetError());
+
+		// tiles repeat a lot, average each image once
+		std::unordered_map<Texture *, SDL_Color> averages;
+
+		for (int x = 0; x < size_x; ++x)
+			for (int y = 0; y < size_y; ++y) {
+				int color[4] = {0, 0, 0, 0};
+
+				// upper layer over lower layer
+				for (auto &layer : tile[x][y]) {
+					if (not layer())
+						continue;
+
+					auto found = averages.find(layer());
+					if (found == averages.end())
+						found = averages.emplace(layer(), layer()->getAverageColor()).first;
+
+					SDL_Color average = found->second;
+					int channel[3] = {average.r, average.g, average.b};
+					int alpha = average.a + color[3] * (255 - average.a) / 255;
+
+					if (alpha == 0)
+						continue;
+
+					for (int c = 0; c < 3; ++c)
+						color[c] = (channel[c] * average.a + color[c] * color[3] * (255 - average.a) / 255) / alpha;
+
+					color[3] = alpha;
+				}
+
+				SDL_Rect rect = {x * minimap_scale, y * minimap_scale, minimap_scale, minimap_scale};
+				SDL_FillRect(surface, &rect, SDL_MapRGBA(surface->format, color[0], color[1], color[2], color[3]));
+			}
+
+		// the cache is optional, a failed save only costs time next load
+		if (not cache.empty())
+			SDL_SaveBMP(surface, cache.string().c_str());
+	}
+
+	minimap = texture_manager->makeImage(surface);
+	SDL_FreeSurface(surface);
+}
+
 GameObject::GameObject(GameManager *parent) :
 	parent(parent),
 	renderer(parent->getRenderer()),
@@ -210,6 +813,11 @@ void GameObject::getCenter(int *x, int *y)
 	*y = screen_y + TILE_SIZE * size_y / 2;
 }
 
+int GameObject::getBottom()
+{
+	return screen_y + size_y * TILE_SIZE;
+}
+
 bool GameObject::isCameraCenter()
 {
 	return camera_center;
@@ -285,20 +893,36 @@ bool GameObject::checkObjectCollision(int offset_x, int offset_y)
 
 void GameObject::render()
 {
+	TextureAccess texture;
+	bool flip = false;
+
 	switch (dir) {
 	case UP:
-		renderer->addRenderItem(up[current_frame], screen_x, screen_y, false, false, 1);
+		texture = up[current_frame];
 		break;
 	case LEFT:
-		renderer->addRenderItem(side[current_frame], screen_x, screen_y, false, false, 1);
+		texture = side[current_frame];
 		break;
 	case DOWN:
-		renderer->addRenderItem(down[current_frame], screen_x, screen_y, false, false, 1);
+		texture = down[current_frame];
 		break;
 	case RIGHT:
-		renderer->addRenderItem(side[current_frame], screen_x, screen_y, true, false, 1);
+		texture = side[current_frame];
+		flip = true;
+		break;
+	case DIR_SIZE:
+		// only counts the directions
 		break;
 	}
+
+	// skip objects outside of the camera
+	if (not texture() or not renderer->isVisible(
+		    screen_x, screen_y,
+		    texture()->getWidth(), texture()->getHeight()
+	    ))
+		return;
+
+	renderer->addRenderItem(texture, screen_x, screen_y, flip, false, 1);
 }
 
 bool GameObject::collide()
@@ -616,6 +1240,10 @@ bool PickupObject::collide()
 	 * to handle pick-up
 	 */
 
+	int center_x, center_y;
+	getCenter(&center_x, &center_y);
+	parent->getParticles()->emit(center_x, center_y, 48, 90, 0.6, WHITE);
+
 	parent->getQuizManager()->startQuiz();
 	parent->useCollectible();
 	parent->addHint(hint);
@@ -695,8 +1323,10 @@ void QuizManager::runTick(uint64_t delta)
 	if (have_answer) {
 		have_answer = false;
 
-		// TODO: inform ui
-		if (answer == questions[question_asked].correct) {
+		bool correct = answer == questions[question_asked].correct;
+		ui_manager->showResult(correct);
+
+		if (correct) {
 			in_quiz = false;
 			ui_manager->endQuiz();
 		} else {
@@ -715,10 +1345,14 @@ GameManager::GameManager(Manager *parent) :
 	renderer(parent->getRenderer()),
 	map_manager(this),
 	quiz_manager(this),
+	// above the upper tiles, one texture so one draw
+	particles(renderer, 4096, 3),
 	playtime(0),
 	paused(false),
+	split_screen(parent->hasOption("--split-screen")),
 	collectibles(0),
-	collected(0)
+	collected(0),
+	hint_count(0)
 {
 	// set renderer size
 	// aspect ratio is 4:3 for classy feel
@@ -727,7 +1361,12 @@ GameManager::GameManager(Manager *parent) :
 
 	// player should always be first object
 	objects.push_back(new Player(this, 0));
-	//objects.push_back(new Player(this, 1));
+
+	// second player on the other half of the keyboard
+	if (parent->hasOption("--coop"))
+		objects.push_back(new Player(this, 1));
+
+	draw_order.assign(objects.begin(), objects.end());
 	
 	// load first hint
 	std::ifstream firsthint("data/firsthint.txt");
@@ -737,6 +1376,13 @@ GameManager::GameManager(Manager *parent) :
 	
 	// debug
 	map_manager.loadMap(2, true);
+
+	// next to the first player
+	if (objects.size() > 1) {
+		int spawn_x, spawn_y;
+		map_manager.getSpawn(&spawn_x, &spawn_y);
+		(*std::next(objects.begin()))->setMapPos(spawn_x + 2, spawn_y, false);
+	}
 }
 
 GameManager::~GameManager()
@@ -765,6 +1411,11 @@ QuizManager *GameManager::getQuizManager()
 	return &quiz_manager;
 }
 
+ParticleSystem *GameManager::getParticles()
+{
+	return &particles;
+}
+
 Player *GameManager::getPlayer()
 {
 	return static_cast<Player *>(objects.front());
@@ -786,6 +1437,7 @@ void GameManager::loadObject(std::filesystem::path object_path, int map_x, int m
 		object_file >> tex >> size_x >> size_y;
 
 		objects.push_back(new StaticObject(this, tex, size_x, size_y, map_x, map_y));
+		draw_order.push_back(objects.back());
 	} else if (type == "pickup") {
 		std::filesystem::path tex;
 		int size_x, size_y;
@@ -795,6 +1447,7 @@ void GameManager::loadObject(std::filesystem::path object_path, int map_x, int m
 		std::getline(object_file, hint);
 
 		objects.push_back(new PickupObject(this, tex, size_x, size_y, map_x, map_y, hint));
+		draw_order.push_back(objects.back());
 	}
 
 	// TODO: add more types
@@ -809,6 +1462,7 @@ void GameManager::unloadObject(GameObject *object)
 
 	if (it != objects.end()) {
 		objects.erase(it);
+		std::erase(draw_order, object);
 
 		// update collision
 		updateCollision();
@@ -905,17 +1559,23 @@ void GameManager::useCollectible()
 void GameManager::addHint(std::string hint)
 {
 	hints.push_back(hint);
+	++hint_count;
 
 	// do not keep all hints
 	while (hints.size() > 1)
 		hints.pop_front();
 }
 
-std::list<std::string> GameManager::getHints()
+const std::list<std::string> &GameManager::getHints()
 {
 	return hints;
 }
 
+unsigned long GameManager::getHintCount()
+{
+	return hint_count;
+}
+
 void GameManager::runTick(uint64_t delta)
 {
 	// compute playtime
@@ -925,8 +1585,8 @@ void GameManager::runTick(uint64_t delta)
 	// update collision map
 	updateCollision();
 
-	// render map tiles
-	map_manager.render();
+	// advance animated tiles
+	map_manager.runTick(delta);
 
 	// calculate camera center
 	int camera_count = 0;
@@ -938,11 +1598,12 @@ void GameManager::runTick(uint64_t delta)
 	int max_x = std::numeric_limits<int>::min();
 	int max_y = std::numeric_limits<int>::min();
 
+	cameras.clear();
+
 	for (auto obj : objects) {
 		// run object tick
 		if (not paused)
 			obj->runTick(delta);
-		obj->render();
 
 		// camera calculations
 		if (obj->isCameraCenter()) {
@@ -950,6 +1611,8 @@ void GameManager::runTick(uint64_t delta)
 
 			obj->getCenter(&tmp_x, &tmp_y);
 
+			cameras.push_back({tmp_x, tmp_y});
+
 			camera_count++;
 			camera_x += tmp_x;
 			camera_y += tmp_y;
@@ -966,15 +1629,67 @@ void GameManager::runTick(uint64_t delta)
 		camera_y /= camera_count;
 	}
 
-	//int size_x = std::abs(max_x - min_x);
-	//int size_y = std::abs(max_y - min_y);
-	//int multiplier = 5;
+	if (split_screen and cameras.size() > 1) {
+		renderer->setViewportCount(cameras.size());
 
-	//while (4 * multiplier * TILE_SIZE < size_x and 3 * multiplier * TILE_SIZE < size_y) 
-		//++multiplier;
+		for (size_t i = 0; i < cameras.size(); ++i) {
+			renderer->setCenter(cameras[i].x, cameras[i].y, i);
+			renderer->setZoom(0, i);
+		}
+	} else {
+		renderer->setViewportCount(1);
+		renderer->setCenter(camera_x, camera_y);
+
+		/*
+		 * zoom out until every camera object fits
+		 * each step halves the map on screen
+		 * and switches to the next chunk level
+		 */
+		static const int margin = 4 * TILE_SIZE;
+		int view_x, view_y, view_w, view_h;
+		int zoom = 0;
+
+		renderer->setZoom(0);
+		renderer->getView(&view_x, &view_y, &view_w, &view_h);
+
+		while (camera_count > 0 and zoom < CHUNK_LEVELS - 1 and
+		       ((view_w << zoom) < max_x - min_x + 2 * margin or
+			(view_h << zoom) < max_y - min_y + 2 * margin))
+			++zoom;
+
+		renderer->setZoom(zoom);
+	}
+
+	/*
+	 * render after the camera moved
+	 * so culling uses this frame's view
+	 */
+	map_manager.render();
+
+	/*
+	 * draw objects by their bottom edge
+	 * last frame's order is almost sorted already
+	 * so an insertion sort only does a few swaps
+	 */
+	for (size_t i = 1; i < draw_order.size(); ++i) {
+		GameObject *obj = draw_order[i];
+		int bottom = obj->getBottom();
+		size_t j = i;
+
+		while (j > 0 and draw_order[j - 1]->getBottom() > bottom) {
+			draw_order[j] = draw_order[j - 1];
+			--j;
+		}
+
+		draw_order[j] = obj;
+	}
+
+	for (auto obj : draw_order)
+		obj->render();
 
-	renderer->setCenter(camera_x, camera_y);
-	//renderer->setSize(4 * multiplier * TILE_SIZE, 3 * multiplier * TILE_SIZE);
+	// sparks keep moving while a pickup's quiz opens
+	particles.update(delta);
+	particles.render();
 	
 	// update quiz if needed
 	quiz_manager.runTick(delta);
@@ -13,7 +13,9 @@ InputHandler::InputHandler() :
 	quit(false),
 	player(DIR_SIZE),
 	player2(DIR_SIZE),
-	answer(3)
+	answer(3),
+	render_reset(false),
+	device_reset(false)
 {}
 
 void InputHandler::processEvents()
@@ -26,6 +28,17 @@ void InputHandler::processEvents()
 			quit = true;
 			break;
 
+		// render target contents were lost
+		case SDL_RENDER_TARGETS_RESET:
+			render_reset = true;
+			break;
+
+		// every texture was lost, targets included
+		case SDL_RENDER_DEVICE_RESET:
+			device_reset = true;
+			render_reset = true;
+			break;
+
 		/*
 		 * for list of available keycodes:
 		 * https://wiki.libsdl.org/SDL_Keycode
@@ -178,3 +191,17 @@ bool InputHandler::isAnswer(int ans, bool clear)
 	if (clear) answer[ans - 1] = false;
 	return ret;
 }
+
+bool InputHandler::isRenderReset(bool clear)
+{
+	bool ret = render_reset;
+	if (clear) render_reset = false;
+	return ret;
+}
+
+bool InputHandler::isDeviceReset(bool clear)
+{
+	bool ret = device_reset;
+	if (clear) device_reset = false;
+	return ret;
+}
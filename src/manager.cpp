@@ -1,5 +1,6 @@
 #include "manager.h"
 
+#include <charconv>
 #include <cstdint>
 #include <stdexcept>
 #include <new>
@@ -27,6 +28,10 @@ Manager::Manager(int argc, char **argv) :
 	current_tick(0),
 	is_quit(false)
 {
+	// headless runs must not need a display
+	if (hasOption("--headless"))
+		SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+
 	if (SDL_Init(SDL_INIT_VIDEO) != 0)
 		throw std::runtime_error(SDL_GetError());
 
@@ -36,7 +41,25 @@ Manager::Manager(int argc, char **argv) :
 	if (TTF_Init() != 0)
 		throw std::runtime_error(TTF_GetError());
 
-	renderer = new Renderer();
+	// command line options
+	int render_flags = RENDER_DEFAULT;
+
+	if (hasOption("--integer-scale"))
+		render_flags |= RENDER_INTEGER_SCALE;
+
+	if (hasOption("--software"))
+		render_flags |= RENDER_SOFTWARE;
+
+	if (hasOption("--headless"))
+		render_flags |= RENDER_HEADLESS;
+
+	renderer = new Renderer(render_flags);
+
+	// before the game sets the frame size
+	std::string capture;
+	if (getOption("--capture", &capture))
+		renderer->startCapture(capture, hasOption("--capture-raw") ? CAPTURE_RAW : CAPTURE_PNG);
+
 	input_handler = new InputHandler();
 	game_manager = new GameManager(this);
 	ui_manager = new UIManager(this);
@@ -73,6 +96,26 @@ UIManager *Manager::getUIManager()
 	return ui_manager;
 }
 
+bool Manager::hasOption(const std::string &option)
+{
+	for (int i = 1; i < argc; ++i)
+		if (option == argv[i])
+			return true;
+
+	return false;
+}
+
+bool Manager::getOption(const std::string &option, std::string *value)
+{
+	for (int i = 1; i + 1 < argc; ++i)
+		if (option == argv[i]) {
+			*value = argv[i + 1];
+			return true;
+		}
+
+	return false;
+}
+
 void Manager::quit()
 {
 	is_quit = true;
@@ -82,6 +125,30 @@ int Manager::operator()()
 {
 	uint64_t delta = 0;
 
+	static const uint64_t max_fps = 60;
+	static const uint64_t min_ticks = 1000 / max_fps;
+
+	/*
+	 * headless runs are uncapped and step the game
+	 * one 60 fps frame at a time, so runs are repeatable
+	 * --frames stops them after that many frames
+	 */
+	bool headless = renderer->isHeadless();
+	uint64_t frame_limit = 0;
+	uint64_t frames = 0;
+
+	std::string value;
+	if (getOption("--frames", &value)) {
+		auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), frame_limit);
+
+		if (error != std::errc() or end != value.data() + value.size() or frame_limit == 0) {
+			SDL_Log("--frames needs a positive number, got \"%s\"", value.c_str());
+			return 1;
+		}
+	}
+
+	uint64_t start = SDL_GetPerformanceCounter();
+
 	while (not is_quit) {
 		/* 
 		 * switch to SDL_GetTicks64 after update to SDL 2.0.18
@@ -90,13 +157,20 @@ int Manager::operator()()
 		// get time passed since last frame
 		last_tick = current_tick;
 		current_tick = SDL_GetTicks();
-		delta = current_tick - last_tick;
+		delta = headless ? min_ticks : current_tick - last_tick;
 
 		// handle events
 		input_handler->processEvents();
 		if (input_handler->isQuit())
 			is_quit = true;
 
+		// textures first, targets are then redrawn into the new ones
+		if (input_handler->isDeviceReset(true))
+			renderer->restoreTextures();
+
+		if (input_handler->isRenderReset(true))
+			renderer->invalidateTargets();
+
 		game_manager->runTick(delta);
 
 		//ui_manager->runTick(delta);
@@ -105,10 +179,13 @@ int Manager::operator()()
 		(*renderer)();
 		renderer->getTextureManager()->cleanup();
 
-		// limit fps
-		static const uint64_t max_fps = 60;
-		static const uint64_t min_ticks = 1000 / max_fps;
+		if (++frames == frame_limit)
+			is_quit = true;
+
+		if (headless)
+			continue;
 
+		// limit fps
 		// calculate time it took to run this frame
 		delta = SDL_GetTicks() - current_tick;
 
@@ -116,5 +193,14 @@ int Manager::operator()()
 			SDL_Delay(min_ticks - delta);
 	}
 
+	if (headless and frames) {
+		double elapsed = static_cast<double>(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency() * 1000;
+
+		SDL_Log(
+			"%llu frames in %.1f ms, %.3f ms per frame",
+			static_cast<unsigned long long>(frames), elapsed, elapsed / frames
+		);
+	}
+
 	return 0;
 }
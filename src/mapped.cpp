@@ -0,0 +1,128 @@
+#include "mapped.h"
+
+#include <algorithm>
+
+#ifdef __unix__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#elif _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <ciso646>
+#else
+#error Unsupported platform
+#endif
+
+#ifdef __unix__
+MappedFile::MappedFile(std::filesystem::path path) :
+	data(nullptr),
+	size(0)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+
+	if (fd < 0)
+		return;
+
+	struct stat info;
+
+	if (fstat(fd, &info) == 0 and info.st_size > 0) {
+		void *view = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (view != MAP_FAILED) {
+			data = static_cast<const uint8_t *>(view);
+			size = info.st_size;
+		}
+	}
+
+	// the mapping keeps its own reference
+	close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+	if (data)
+		munmap(const_cast<uint8_t *>(data), size);
+}
+
+void MappedFile::prefetch(size_t offset, size_t size)
+{
+	if (not data or offset >= this->size)
+		return;
+
+	// madvise wants a page aligned start
+	static const size_t page = sysconf(_SC_PAGESIZE);
+	size_t start = offset / page * page;
+	size_t end = std::min(offset + size, this->size);
+
+	madvise(const_cast<uint8_t *>(data) + start, end - start, MADV_WILLNEED);
+}
+#elif _WIN32
+MappedFile::MappedFile(std::filesystem::path path) :
+	data(nullptr),
+	size(0),
+	file(INVALID_HANDLE_VALUE),
+	mapping(NULL)
+{
+	file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER file_size;
+
+	if (not GetFileSizeEx(file, &file_size) or file_size.QuadPart == 0)
+		return;
+
+	mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+	if (not mapping)
+		return;
+
+	data = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+	if (data)
+		size = file_size.QuadPart;
+}
+
+MappedFile::~MappedFile()
+{
+	if (data)
+		UnmapViewOfFile(data);
+
+	if (mapping)
+		CloseHandle(mapping);
+
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+}
+
+void MappedFile::prefetch(size_t offset, size_t size)
+{
+	if (not data or offset >= this->size)
+		return;
+
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = const_cast<uint8_t *>(data) + offset;
+	range.NumberOfBytes = std::min(size, this->size - offset);
+
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+#endif
+
+bool MappedFile::isOpen()
+{
+	return data;
+}
+
+const uint8_t *MappedFile::getData()
+{
+	return data;
+}
+
+size_t MappedFile::getSize()
+{
+	return size;
+}
@@ -0,0 +1,169 @@
+#include "particles.h"
+
+#include <cmath>
+#include <numbers>
+#include <random>
+#include <stdexcept>
+
+#ifdef __unix__
+#include <SDL2/SDL.h>
+#elif _WIN32
+#include <ciso646>
+#include <SDL.h>
+#else
+#error Unsupported platform
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PARTICLE_SIMD
+#include <immintrin.h>
+#endif
+
+// pixels per second squared, pulls sparks back down
+#define PARTICLE_GRAVITY 240.0f
+// side of the square drawn for each particle
+#define PARTICLE_SIZE 2
+
+ParticleSystem::ParticleSystem(Renderer *renderer, int capacity, int layer, bool overlay) :
+	renderer(renderer),
+	layer(layer),
+	overlay(overlay),
+	capacity(capacity),
+	count(0),
+	x(capacity),
+	y(capacity),
+	vx(capacity),
+	vy(capacity),
+	life(capacity),
+	lifetime(capacity),
+	color(capacity)
+{
+	if (not renderer)
+		return;
+
+	/*
+	 * every particle is the same white square
+	 * tinted per vertex, so a whole layer of them
+	 * stays a single batched draw
+	 * it is a tiny texture of its own, packing it
+	 * would pin or open a whole atlas page
+	 */
+	SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, PARTICLE_SIZE, PARTICLE_SIZE, 32, SDL_PIXELFORMAT_RGBA32);
+
+	if (not surface)
+		throw std::runtime_error(SDL_GetError());
+
+	SDL_FillRect(surface, NULL, SDL_MapRGBA(surface->format, 255, 255, 255, 255));
+	spark = renderer->getTextureManager()->makeImage(surface);
+	SDL_FreeSurface(surface);
+}
+
+void ParticleSystem::emit(int x, int y, int count, float speed, float lifetime, COLOR color)
+{
+	static std::random_device r;
+	static std::default_random_engine e(r());
+	static std::uniform_real_distribution<float> angle(0, 2 * std::numbers::pi_v<float>);
+	static std::uniform_real_distribution<float> spread(0.5, 1);
+
+	for (int i = 0; i < count and this->count < capacity; ++i) {
+		int slot = this->count++;
+		float a = angle(e);
+		float v = speed * spread(e);
+
+		this->x[slot] = x;
+		this->y[slot] = y;
+		vx[slot] = std::cos(a) * v;
+		// bias upwards so the burst fountains
+		vy[slot] = std::sin(a) * v - speed / 2;
+		life[slot] = this->lifetime[slot] = lifetime * spread(e);
+		this->color[slot] = color;
+	}
+}
+
+void ParticleSystem::clear()
+{
+	count = 0;
+}
+
+int ParticleSystem::getCount()
+{
+	return count;
+}
+
+int ParticleSystem::getCapacity()
+{
+	return capacity;
+}
+
+void ParticleSystem::update(uint64_t delta)
+{
+	float dt = delta / 1000.0f;
+	float fall = PARTICLE_GRAVITY * dt;
+
+	float *px = x.data();
+	float *py = y.data();
+	float *pvx = vx.data();
+	float *pvy = vy.data();
+	float *plife = life.data();
+
+	int i = 0;
+
+#ifdef PARTICLE_SIMD
+	// same steps as the loop below, four particles per register
+	__m128 dt4 = _mm_set1_ps(dt);
+	__m128 fall4 = _mm_set1_ps(fall);
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 vy4 = _mm_add_ps(_mm_loadu_ps(pvy + i), fall4);
+		_mm_storeu_ps(pvy + i, vy4);
+
+		_mm_storeu_ps(px + i, _mm_add_ps(_mm_loadu_ps(px + i), _mm_mul_ps(_mm_loadu_ps(pvx + i), dt4)));
+		_mm_storeu_ps(py + i, _mm_add_ps(_mm_loadu_ps(py + i), _mm_mul_ps(vy4, dt4)));
+		_mm_storeu_ps(plife + i, _mm_sub_ps(_mm_loadu_ps(plife + i), dt4));
+	}
+#endif
+
+	for (; i < count; ++i) {
+		pvy[i] += fall;
+		px[i] += pvx[i] * dt;
+		py[i] += pvy[i] * dt;
+		plife[i] -= dt;
+	}
+
+	// keep live particles packed at the front
+	for (i = 0; i < count;) {
+		if (life[i] > 0) {
+			++i;
+			continue;
+		}
+
+		--count;
+		x[i] = x[count];
+		y[i] = y[count];
+		vx[i] = vx[count];
+		vy[i] = vy[count];
+		life[i] = life[count];
+		lifetime[i] = lifetime[count];
+		color[i] = color[count];
+	}
+}
+
+void ParticleSystem::render()
+{
+	if (not renderer or not spark())
+		return;
+
+	for (int i = 0; i < count; ++i) {
+		RenderItem item(
+			spark,
+			static_cast<int>(x[i]) - PARTICLE_SIZE / 2,
+			static_cast<int>(y[i]) - PARTICLE_SIZE / 2,
+			false, false, layer, overlay,
+			static_cast<COLOR>(color[i])
+		);
+
+		// fade out over the particle's life
+		item.setOpacity(255 * life[i] / lifetime[i]);
+		renderer->addRenderItem(item);
+	}
+}
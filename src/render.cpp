@@ -1,10 +1,13 @@
 #include "render.h"
 
 #include "config.h"
+#include "utilities.h"
 
 #include <stdexcept>
-#include <compare>
 #include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
 
 #ifdef __unix__
 #include <SDL2/SDL_image.h>
@@ -15,18 +18,157 @@
 #error Unsupported platform
 #endif
 
-Texture::Texture(Renderer *renderer, std::filesystem::path path, bool keep) :
-	path(path),
-	usage(0),
-	keep(keep)
+SDL_Color getColor(COLOR color)
 {
-	SDL_Surface *surface;
-	if (!path.empty() and std::filesystem::exists(path)) {
-		surface = IMG_Load(path.string().c_str());
+	SDL_Color color_real = {0, 0, 0, 255};
 
-		if (!surface)
-			throw std::runtime_error(IMG_GetError());
-	} else {
+	switch (color) {
+	default:
+	case BLACK:
+		color_real = {0, 0, 0, 255};
+		break;
+
+	case GRAY:
+		color_real = {169, 169, 169, 255};
+		break;
+
+	case WHITE:
+		color_real = {255, 255, 255, 255};
+		break;
+
+	case RED:
+		color_real = {255, 0, 0, 255};
+		break;
+
+	case GREEN:
+		color_real = {0, 255, 0, 255};
+		break;
+
+	case BLUE:
+		color_real = {0, 0, 255, 255};
+		break;
+	}
+
+	return color_real;
+}
+
+static SDL_RendererFlip getFlip(const RenderItem &item)
+{
+	return static_cast<SDL_RendererFlip>(
+		(SDL_FLIP_VERTICAL and 
+		 item.getFlipVert()) |
+		(SDL_FLIP_VERTICAL and
+		 item.getFlipHorz())
+	);
+}
+
+static ALPHA classifyAlpha(SDL_Surface *surface)
+{
+	// surface must be RGBA32, alpha is the last byte of every pixel
+	bool empty = true;
+	bool opaque = true;
+
+	for (int y = 0; y < surface->h; ++y) {
+		auto *row = static_cast<uint8_t *>(surface->pixels) + y * surface->pitch;
+
+		for (int x = 0; x < surface->w; ++x) {
+			uint8_t a = row[4 * x + 3];
+
+			empty = empty and a == 0;
+			opaque = opaque and a == 255;
+		}
+
+		if (not empty and not opaque)
+			return ALPHA_MIXED;
+	}
+
+	if (empty)
+		return ALPHA_EMPTY;
+
+	return ALPHA_OPAQUE;
+}
+
+static SDL_Color averageColor(SDL_Surface *surface)
+{
+	// alpha weighted mean of an RGBA32 surface
+	uint64_t sum[4] = {0, 0, 0, 0};
+
+	for (int y = 0; y < surface->h; ++y) {
+		auto *row = static_cast<uint8_t *>(surface->pixels) + y * surface->pitch;
+
+		for (int x = 0; x < surface->w; ++x) {
+			uint8_t *pixel = row + 4 * x;
+
+			for (int c = 0; c < 3; ++c)
+				sum[c] += pixel[c] * pixel[3];
+			sum[3] += pixel[3];
+		}
+	}
+
+	if (sum[3] == 0)
+		return {0, 0, 0, 0};
+
+	return {
+		static_cast<uint8_t>(sum[0] / sum[3]),
+		static_cast<uint8_t>(sum[1] / sum[3]),
+		static_cast<uint8_t>(sum[2] / sum[3]),
+		static_cast<uint8_t>(sum[3] / (surface->w * surface->h))
+	};
+}
+
+static uint64_t hashSurface(SDL_Surface *surface)
+{
+	// FNV-1a over size and RGBA32 pixels
+	uint64_t hash = hashBytes(&surface->w, sizeof(surface->w));
+	hash = hashBytes(&surface->h, sizeof(surface->h), hash);
+
+	for (int y = 0; y < surface->h; ++y)
+		hash = hashBytes(
+			static_cast<const uint8_t *>(surface->pixels) + y * surface->pitch,
+			surface->w * sizeof(uint32_t),
+			hash
+		);
+
+	return hash;
+}
+
+static SDL_Surface *loadSurface(std::filesystem::path path, Renderer *renderer)
+{
+	AssetPack *assets = renderer->getAssets();
+	TextureCache *cache = renderer->getTextureCache();
+
+	SDL_Surface *surface = nullptr;
+	int64_t mtime;
+	uint64_t size;
+
+	// packed files need no open or stat
+	if (assets->getStamp(path, &mtime, &size)) {
+		// decoded on an earlier run and unchanged since
+		surface = cache->load(path, mtime, size);
+
+		if (surface)
+			return surface;
+
+		SDL_RWops *file = assets->open(path);
+
+		if (file) {
+			SDL_Surface *loaded = IMG_Load_RW(file, 1);
+
+			if (!loaded)
+				throw std::runtime_error(IMG_GetError());
+
+			// the cache holds RGBA32, the atlas wants it as well
+			surface = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+			SDL_FreeSurface(loaded);
+
+			if (!surface)
+				throw std::runtime_error(SDL_GetError());
+
+			cache->store(path, mtime, size, surface);
+		}
+	}
+
+	if (not surface) {
 		// create missing texture
 		surface = SDL_CreateRGBSurface(
 				0, 
@@ -40,72 +182,430 @@ Texture::Texture(Renderer *renderer, std::filesystem::path path, bool keep) :
 		SDL_FillRect(surface, NULL, SDL_MapRGB(surface->format, 169, 169, 169));
 	}
 
-	texture = SDL_CreateTextureFromSurface(renderer->getRenderer(), surface);
+	return surface;
+}
+
+// what SDL_CreateTextureFromSurface would pick
+static SDL_BlendMode getSurfaceBlendMode(SDL_Surface *surface)
+{
+	if (surface->format->Amask or SDL_HasColorKey(surface))
+		return SDL_BLENDMODE_BLEND;
+
+	return SDL_BLENDMODE_NONE;
+}
+
+Texture::Texture(Renderer *renderer, std::filesystem::path path, bool keep) :
+	texture(nullptr),
+	path(path),
+	usage(0),
+	keep(keep),
+	page(false),
+	atlas(nullptr),
+	shadow(nullptr),
+	dirty(false),
+	bitmap(nullptr),
+	alpha(ALPHA_MIXED),
+	hash(0),
+	average({169, 169, 169, 255})
+{
+	SDL_Surface *surface = loadSurface(path, renderer);
+
+	width = surface->w;
+	height = surface->h;
+	source = {0, 0, width, height};
+	blend_mode = getSurfaceBlendMode(surface);
+
+	// the software renderer reads its own copy and never uploads it
+	if (renderer->isSoftware())
+		bitmap = new Bitmap(surface);
+	else
+		texture = SDL_CreateTextureFromSurface(renderer->getRenderer(), surface);
 
 	SDL_FreeSurface(surface);
 
+	if (!texture and !bitmap)
+		throw std::runtime_error(SDL_GetError());
+}
+
+Texture::Texture(Renderer *renderer, SDL_Surface *surface) :
+	texture(nullptr),
+	path(""),
+	width(surface->w),
+	height(surface->h),
+	usage(0),
+	keep(false),
+	page(false),
+	source({0, 0, surface->w, surface->h}),
+	atlas(nullptr),
+	shadow(nullptr),
+	dirty(false),
+	bitmap(nullptr),
+	blend_mode(getSurfaceBlendMode(surface)),
+	alpha(ALPHA_MIXED),
+	hash(0),
+	average({169, 169, 169, 255})
+{
+	// image made at runtime, the caller keeps the surface
+	if (renderer->isSoftware()) {
+		bitmap = new Bitmap(surface);
+		return;
+	}
+
+	texture = SDL_CreateTextureFromSurface(renderer->getRenderer(), surface);
+
 	if (!texture)
 		throw std::runtime_error(SDL_GetError());
 
-	SDL_QueryTexture(texture, NULL, NULL, &width, &height);
+	// nothing to load it from again after a device reset
+	shadow = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+
+	if (!shadow) {
+		SDL_DestroyTexture(texture);
+		throw std::runtime_error(SDL_GetError());
+	}
 }
 
-Texture::Texture(Renderer *renderer, std::string text, COLOR color, bool keep) :
+Texture::Texture(Renderer *renderer, int width, int height, SDL_TextureAccess access) :
+	texture(nullptr),
 	path(""),
+	width(width),
+	height(height),
 	usage(0),
-	keep(keep)
+	keep(false),
+	page(access == SDL_TEXTUREACCESS_STATIC),
+	source({0, 0, width, height}),
+	atlas(nullptr),
+	shadow(nullptr),
+	dirty(false),
+	bitmap(nullptr),
+	blend_mode(SDL_BLENDMODE_BLEND),
+	alpha(ALPHA_MIXED),
+	hash(0),
+	average({169, 169, 169, 255})
 {
-	SDL_Color color_real = {0, 0, 0};
+	/*
+	 * static textures are empty atlas pages
+	 * regions are written to the shadow surface first
+	 * and uploaded in one go by TextureManager::updateAtlas
+	 *
+	 * target textures are filled by Renderer::renderToTexture
+	 *
+	 * in software mode the shadow is a view of the bitmap
+	 * so packing a region needs no upload at all,
+	 * and only the streaming frame gets an SDL_Texture
+	 */
+	if (renderer->isSoftware())
+		bitmap = new Bitmap(width, height);
+
+	if (access == SDL_TEXTUREACCESS_STATIC and bitmap)
+		shadow = SDL_CreateRGBSurfaceWithFormatFrom(
+				bitmap->getPixels(),
+				width, height, 32,
+				bitmap->getPitch() * sizeof(uint32_t),
+				SDL_PIXELFORMAT_RGBA32
+			);
+	else if (access == SDL_TEXTUREACCESS_STATIC)
+		shadow = SDL_CreateRGBSurfaceWithFormat(
+				0,
+				width, height, 32,
+				SDL_PIXELFORMAT_RGBA32
+			);
 
-	switch (color) {
-	default:
-	case BLACK:
-		color_real = {0, 0, 0};
-		break;
+	if (access == SDL_TEXTUREACCESS_STATIC and !shadow) {
+		delete bitmap;
+		throw std::runtime_error(SDL_GetError());
+	}
 
-	case GRAY:
-		color_real = {169, 169, 169};
-		break;
+	if (bitmap and access != SDL_TEXTUREACCESS_STREAMING)
+		return;
 
-	case WHITE:
-		color_real = {255, 255, 255};
-		break;
+	texture = SDL_CreateTexture(
+			renderer->getRenderer(),
+			SDL_PIXELFORMAT_RGBA32,
+			access,
+			width, height
+		);
 
-	case RED:
-		color_real = {255, 0, 0};
-		break;
+	if (!texture) {
+		if (shadow)
+			SDL_FreeSurface(shadow);
+		delete bitmap;
+		throw std::runtime_error(SDL_GetError());
+	}
 
-	case GREEN:
-		color_real = {0, 255, 0};
-		break;
+	SDL_SetTextureBlendMode(texture, blend_mode);
+}
 
-	case BLUE:
-		color_real = {0, 0, 255};
-		break;
+Texture::Texture(Texture *atlas, SDL_Rect source, std::filesystem::path path, ALPHA alpha, uint64_t hash, SDL_Color average) :
+	texture(atlas->getTexture()),
+	path(path),
+	width(source.w),
+	height(source.h),
+	usage(0),
+	keep(false),
+	page(false),
+	source(source),
+	atlas(atlas),
+	shadow(nullptr),
+	dirty(false),
+	bitmap(atlas->getBitmap()),
+	blend_mode(SDL_BLENDMODE_BLEND),
+	alpha(alpha),
+	hash(hash),
+	average(average)
+{
+	// keep the page alive for as long as the region is
+	atlas->addUsage();
+}
+
+Texture::~Texture()
+{
+	if (atlas) {
+		atlas->remUsage();
+		return;
 	}
 
-	SDL_Surface *surface = TTF_RenderUTF8_Solid(
-			renderer->getFont(), 
-			text.c_str(), 
-			color_real
-		);
+	if (texture)
+		SDL_DestroyTexture(texture);
 
-	if (!surface)
-		throw std::runtime_error(TTF_GetError());
+	// the shadow may point into the bitmap
+	if (shadow)
+		SDL_FreeSurface(shadow);
 
-	texture = SDL_CreateTextureFromSurface(renderer->getRenderer(), surface);
+	delete bitmap;
+}
 
-	SDL_FreeSurface(surface);
+void Texture::update(SDL_Surface *surface, SDL_Rect rect)
+{
+	/*
+	 * copy an RGBA32 surface into the shadow at rect
+	 * border pixels are repeated once on every side
+	 * so that scaled draws never sample a neighbour
+	 */
+	auto *src = static_cast<uint8_t *>(surface->pixels);
+	auto *dst = static_cast<uint8_t *>(shadow->pixels);
+
+	for (int y = -1; y <= rect.h; ++y) {
+		int src_y = std::clamp(y, 0, rect.h - 1);
+		auto *src_row = reinterpret_cast<uint32_t *>(src + src_y * surface->pitch);
+		auto *dst_row = reinterpret_cast<uint32_t *>(dst + (rect.y + y) * shadow->pitch) + rect.x;
+
+		std::memcpy(dst_row, src_row, rect.w * sizeof(uint32_t));
+		dst_row[-1] = src_row[0];
+		dst_row[rect.w] = src_row[rect.w - 1];
+	}
 
-	if (!texture)
+	dirty = true;
+}
+
+bool Texture::matches(SDL_Surface *surface)
+{
+	// compare an RGBA32 surface with the pixels of this atlas region
+	if (not atlas or not atlas->shadow or surface->w != source.w or surface->h != source.h)
+		return false;
+
+	auto *src = static_cast<uint8_t *>(surface->pixels);
+	auto *dst = static_cast<uint8_t *>(atlas->shadow->pixels);
+
+	for (int y = 0; y < source.h; ++y)
+		if (std::memcmp(
+			    src + y * surface->pitch,
+			    dst + (source.y + y) * atlas->shadow->pitch + source.x * sizeof(uint32_t),
+			    source.w * sizeof(uint32_t)
+		    ))
+			return false;
+
+	return true;
+}
+
+SDL_Color Texture::getAverageColor()
+{
+	// worked out when packing, pages may no longer have the pixels
+	return average;
+}
+
+void Texture::show(Texture *frame)
+{
+	/*
+	 * point a view at another image
+	 * the frames themselves must be kept alive by the caller
+	 */
+	texture = frame->texture;
+	bitmap = frame->bitmap;
+	source = frame->source;
+	width = frame->width;
+	height = frame->height;
+
+	// frames may sit on pages of other sizes, uvs are taken from this one
+	Texture *base = frame->atlas ? frame->atlas : frame;
+
+	if (base != atlas) {
+		base->addUsage();
+		atlas->remUsage();
+		atlas = base;
+	}
+}
+
+bool Texture::upload()
+{
+	if (not dirty)
+		return false;
+
+	// software pages are read straight from the bitmap
+	if (bitmap) {
+		dirty = false;
+		return true;
+	}
+
+	if (SDL_UpdateTexture(texture, NULL, shadow->pixels, shadow->pitch))
 		throw std::runtime_error(SDL_GetError());
 
-	SDL_QueryTexture(texture, NULL, NULL, &width, &height);
+	dirty = false;
+	return true;
 }
 
-Texture::~Texture()
+void Texture::replace(Texture &other, std::list<Texture> &textures)
+{
+	/*
+	 * take over the texture, bitmap and shadow of other
+	 * regions and views copy those of their page,
+	 * so everything still pointing at ours moves along
+	 * other ends up with the old ones and frees them
+	 */
+	for (auto &region : textures)
+		if (region.atlas == this) {
+			region.texture = other.texture;
+			region.bitmap = other.bitmap;
+		}
+
+	std::swap(texture, other.texture);
+	std::swap(bitmap, other.bitmap);
+	std::swap(shadow, other.shadow);
+}
+
+void Texture::grow(Renderer *renderer, int size, std::list<Texture> &textures)
+{
+	// enlarge an atlas page, its regions keep their place
+	Texture larger(renderer, size, size, SDL_TEXTUREACCESS_STATIC);
+
+	for (int y = 0; y < height; ++y)
+		std::memcpy(
+			static_cast<uint8_t *>(larger.shadow->pixels) + y * larger.shadow->pitch,
+			static_cast<uint8_t *>(shadow->pixels) + y * shadow->pitch,
+			width * sizeof(uint32_t)
+		);
+
+	replace(larger, textures);
+
+	width = size;
+	height = size;
+	source = {0, 0, size, size};
+	dirty = true;
+}
+
+void Texture::dropShadow()
+{
+	// software pages draw from the bitmap the shadow views
+	if (not shadow or bitmap or dirty)
+		return;
+
+	SDL_FreeSurface(shadow);
+	shadow = nullptr;
+}
+
+bool Texture::hasShadow()
+{
+	return shadow;
+}
+
+void Texture::restore(Renderer *renderer, std::list<Texture> &textures)
+{
+	/*
+	 * make the SDL_Texture again after the device lost it
+	 * targets come back empty and are redrawn by their owners,
+	 * pages and runtime images come back from their shadow,
+	 * pages that dropped it are refilled from their regions' files
+	 * and the rest are loaded from their file again
+	 */
+	// software images live in their bitmap only
+	if (atlas or not texture)
+		return;
+
+	int access;
+	SDL_QueryTexture(texture, NULL, &access, NULL, NULL);
+#if SDL_VERSION_ATLEAST(2, 0, 12)
+	SDL_ScaleMode scale_mode;
+	SDL_GetTextureScaleMode(texture, &scale_mode);
+#endif
+
+	if (access != SDL_TEXTUREACCESS_STATIC) {
+		Texture fresh(renderer, width, height, static_cast<SDL_TextureAccess>(access));
+		replace(fresh, textures);
+	} else if (page) {
+		Texture fresh(renderer, width, height, SDL_TEXTUREACCESS_STATIC);
+		bool dropped = not shadow;
+
+		if (dropped) {
+			for (auto &region : textures) {
+				if (region.atlas != this or region.path.empty())
+					continue;
+
+				SDL_Surface *loaded = loadSurface(region.path, renderer);
+				SDL_Surface *surface = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+				SDL_FreeSurface(loaded);
+
+				if (!surface)
+					throw std::runtime_error(SDL_GetError());
+
+				fresh.update(surface, region.source);
+				SDL_FreeSurface(surface);
+			}
+		} else {
+			for (int y = 0; y < height; ++y)
+				std::memcpy(
+					static_cast<uint8_t *>(fresh.shadow->pixels) + y * fresh.shadow->pitch,
+					static_cast<uint8_t *>(shadow->pixels) + y * shadow->pitch,
+					width * sizeof(uint32_t)
+				);
+		}
+
+		replace(fresh, textures);
+
+		dirty = true;
+		upload();
+
+		if (dropped)
+			dropShadow();
+	} else if (shadow) {
+		Texture fresh(renderer, shadow);
+		replace(fresh, textures);
+	} else {
+		Texture fresh(renderer, path);
+		replace(fresh, textures);
+	}
+
+	SDL_SetTextureBlendMode(texture, blend_mode);
+#if SDL_VERSION_ATLEAST(2, 0, 12)
+	SDL_SetTextureScaleMode(texture, scale_mode);
+#endif
+}
+
+void Texture::setBlendMode(SDL_BlendMode mode)
+{
+	if (atlas) {
+		atlas->setBlendMode(mode);
+		return;
+	}
+
+	blend_mode = mode;
+
+	if (texture)
+		SDL_SetTextureBlendMode(texture, mode);
+}
+
+SDL_BlendMode Texture::getBlendMode()
 {
-	SDL_DestroyTexture(texture);
+	return atlas ? atlas->getBlendMode() : blend_mode;
 }
 
 SDL_Texture *Texture::getTexture()
@@ -113,6 +613,16 @@ SDL_Texture *Texture::getTexture()
 	return texture;
 }
 
+Bitmap *Texture::getBitmap()
+{
+	return bitmap;
+}
+
+const SDL_Rect *Texture::getSource()
+{
+	return &source;
+}
+
 std::filesystem::path Texture::getPath()
 {
 	return path;
@@ -128,6 +638,18 @@ int Texture::getHeight()
 	return height;
 }
 
+void Texture::getTextureSize(int *width, int *height)
+{
+	// size of the whole SDL_Texture, the page for atlas regions
+	if (atlas) {
+		atlas->getTextureSize(width, height);
+		return;
+	}
+
+	*width = this->width;
+	*height = this->height;
+}
+
 long Texture::addUsage()
 {
 	return ++usage;
@@ -148,6 +670,21 @@ bool Texture::isKeep()
 	return keep;
 }
 
+ALPHA Texture::getAlpha()
+{
+	return alpha;
+}
+
+Texture *Texture::getAtlas()
+{
+	return atlas;
+}
+
+uint64_t Texture::getHash()
+{
+	return hash;
+}
+
 bool Texture::operator==(const Texture &other) const
 {
 	return path == other.path;
@@ -173,7 +710,7 @@ TextureAccess::~TextureAccess()
 		texture->remUsage();
 }
 
-Texture *TextureAccess::operator()()
+Texture *TextureAccess::operator()() const
 {
 	return texture;
 }
@@ -200,10 +737,30 @@ bool TextureAccess::operator==(const TextureAccess &other) const
 }
 
 TextureManager::TextureManager(Renderer *parent) :
-	parent(parent)
+	parent(parent),
+	atlas_size(ATLAS_SIZE),
+	atlas({nullptr, 0, 0, 0}),
+	glyphs({nullptr, 0, 0, 0})
 {
 	// initialize missing texture
 	textures.emplace_back(parent, std::filesystem::path(""), true);
+	paths[""] = &textures.front();
+
+	// do not ask for pages larger than the renderer can hold
+	SDL_RendererInfo info;
+	if (SDL_GetRendererInfo(parent->getRenderer(), &info) == 0) {
+		if (info.max_texture_width > 0)
+			atlas_size = std::min(atlas_size, info.max_texture_width);
+		if (info.max_texture_height > 0)
+			atlas_size = std::min(atlas_size, info.max_texture_height);
+	}
+}
+
+TextureManager::~TextureManager()
+{
+	// regions let go of their page when destroyed, so pages go last
+	while (not textures.empty())
+		textures.pop_back();
 }
 
 TextureAccess TextureManager::getMissingTexture()
@@ -211,77 +768,298 @@ TextureAccess TextureManager::getMissingTexture()
 	return TextureAccess(&textures.front());
 }
 
-TextureAccess TextureManager::loadTexture(std::filesystem::path path)
+TextureAccess TextureManager::loadTexture(std::filesystem::path path, bool pack)
 {
-	for (auto it = textures.begin(); it != textures.end(); ++it)
-		if (it->getPath() == path)
-			return TextureAccess(&(*it));
+	auto found = paths.find(path.string());
+	if (found != paths.end())
+		return TextureAccess(found->second);
 
-	textures.emplace_back(parent, path);
-	return TextureAccess(&textures.back());
+	Texture *texture = nullptr;
+
+	// small images share atlas pages
+	if (pack) {
+		SDL_Surface *surface = loadSurface(path, parent);
+		texture = packTexture(surface, path, atlas);
+		SDL_FreeSurface(surface);
+	}
+
+	if (not texture) {
+		textures.emplace_back(parent, path);
+		texture = &textures.back();
+	}
+
+	paths[path.string()] = texture;
+	return TextureAccess(texture);
 }
 
-TextureAccess TextureManager::makeText(std::string text, COLOR color)
+TextureAccess TextureManager::packSurface(SDL_Surface *surface)
 {
-	textures.emplace_back(parent, text, color);
-	return TextureAccess(&textures.back());
+	// empty access if the surface does not fit a page
+	return TextureAccess(packTexture(surface, "", atlas));
 }
 
-void TextureManager::cleanup()
+TextureAccess TextureManager::packGlyph(SDL_Surface *surface)
 {
-	size_t size = textures.size();
-	auto it = textures.begin();
-	while (it != textures.end())
-		if (it->getUsage() < 1 and not it->isKeep())
-			it = textures.erase(it);
-		else
-			it++;
-	size = textures.size();
+	// like packSurface, on a page that only holds glyphs
+	return TextureAccess(packTexture(surface, "", glyphs));
 }
 
-RenderItem::RenderItem(TextureAccess texture, int pos_x, int pos_y, bool flip_vert, bool flip_horz, int layer, bool overlay) :
-	texture(texture),
-	pos_x(pos_x),
-	pos_y(pos_y),
-	flip_vert(flip_vert),
-	flip_horz(flip_horz),
-	layer(layer),
-	overlay(overlay)
-{}
-
-/*
-void RenderItem::setTexture(TextureAccess texture)
+TextureAccess TextureManager::makeView(const TextureAccess &frame)
 {
-        this->texture = texture;
+	// region that can later show other images, see Texture::show
+	Texture *base = frame()->getAtlas() ? frame()->getAtlas() : frame();
+
+	textures.emplace_back(
+		base, *frame()->getSource(), std::filesystem::path(""),
+		ALPHA_MIXED, 0, frame()->getAverageColor()
+	);
+	return TextureAccess(&textures.back());
 }
 
-void RenderItem::setX(int pos_x)
+TextureAccess TextureManager::makeImage(SDL_Surface *surface)
 {
-        this->pos_x = pos_x;
+	textures.emplace_back(parent, surface);
+	return TextureAccess(&textures.back());
 }
 
-void RenderItem::setY(int pos_y)
+TextureAccess TextureManager::makeRegion(const TextureAccess &texture, SDL_Rect source)
 {
-        this->pos_y = pos_y;
+	// part of a standalone texture, e.g. one frame of a sprite sheet
+	textures.emplace_back(texture(), source, std::filesystem::path(""));
+	return TextureAccess(&textures.back());
 }
 
-void RenderItem::setLayer(int layer)
+TextureAccess TextureManager::makeTarget(int width, int height)
 {
-        this->layer = layer;
+	textures.emplace_back(parent, width, height, SDL_TEXTUREACCESS_TARGET);
+	return TextureAccess(&textures.back());
 }
-*/
 
-TextureAccess RenderItem::getTexture() const
+TextureAccess TextureManager::makeFrame(int width, int height)
 {
-	return texture;
+	// software frames are composed in their bitmap and streamed up once each
+	SDL_TextureAccess access = parent->isSoftware() ? SDL_TEXTUREACCESS_STREAMING : SDL_TEXTUREACCESS_TARGET;
+
+	textures.emplace_back(parent, width, height, access);
+	return TextureAccess(&textures.back());
 }
 
-int RenderItem::getX() const
+void TextureManager::closeAtlas()
 {
-	return pos_x;
+	// next packed texture starts a fresh page
+	closePage(atlas);
 }
 
-int RenderItem::getY() const
+void TextureManager::closePage(PAGE &page)
+{
+	// updateAtlas drops its shadow once it is uploaded
+	if (page.texture and std::find(pending.begin(), pending.end(), page.texture) == pending.end())
+		pending.push_back(page.texture);
+
+	page.texture = nullptr;
+}
+
+void TextureManager::updateAtlas()
+{
+	for (auto page : pending) {
+		page->upload();
+
+		// finished pages only live on the gpu from now on
+		if (page != atlas.texture and page != glyphs.texture)
+			page->dropShadow();
+	}
+
+	pending.clear();
+}
+
+void TextureManager::restore()
+{
+	// after a device reset every SDL_Texture is gone
+	for (auto &texture : textures)
+		texture.restore(parent, textures);
+}
+
+void TextureManager::cleanup()
+{
+	size_t size = textures.size();
+	auto it = textures.begin();
+	while (it != textures.end())
+		if (it->getUsage() < 1 and not it->isKeep() and
+		    &(*it) != atlas.texture and &(*it) != glyphs.texture) {
+			auto found = paths.find(it->getPath().string());
+			if (found != paths.end() and found->second == &(*it))
+				paths.erase(found);
+
+			auto same = hashes.find(it->getHash());
+			if (same != hashes.end() and same->second == &(*it))
+				hashes.erase(same);
+
+			std::erase(pending, &(*it));
+
+			it = textures.erase(it);
+		} else {
+			it++;
+		}
+	size = textures.size();
+}
+
+Texture *TextureManager::packTexture(SDL_Surface *loaded, std::filesystem::path path, PAGE &page)
+{
+	SDL_Surface *surface = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+
+	if (!surface)
+		throw std::runtime_error(SDL_GetError());
+
+	// one pixel of padding on every side
+	int cell_w = surface->w + 2;
+	int cell_h = surface->h + 2;
+
+	if (surface->w < 1 or surface->h < 1 or
+	    cell_w > atlas_size or cell_h > atlas_size) {
+		// does not fit a page, caller loads it standalone
+		SDL_FreeSurface(surface);
+		return nullptr;
+	}
+
+	// identical images share one slot
+	uint64_t hash = hashSurface(surface);
+	auto found = hashes.find(hash);
+
+	/*
+	 * glyphs only share with glyphs,
+	 * or they would keep a map's page alive
+	 */
+	bool shared = found != hashes.end() and
+		      (&page != &glyphs or found->second->getAtlas() == glyphs.texture);
+
+	if (shared and found->second->matches(surface)) {
+		Texture *same = found->second;
+		SDL_FreeSurface(surface);
+
+		textures.emplace_back(same->getAtlas(), *same->getSource(), path, same->getAlpha(), hash, same->getAverageColor());
+		return &textures.back();
+	}
+
+	// room on this shelf or the next one
+	auto fits = [&](int size) {
+		return (page.x + cell_w <= size and page.y + cell_h <= size) or
+		       (cell_w <= size and page.y + page.shelf_height + cell_h <= size);
+	};
+
+	// the open page grows before another one is started
+	while (page.texture and not fits(page.texture->getWidth()) and page.texture->getWidth() < atlas_size)
+		page.texture->grow(parent, std::min(page.texture->getWidth() * 2, atlas_size), textures);
+
+	// start a new page, just big enough to begin with
+	if (not page.texture or not fits(page.texture->getWidth())) {
+		closePage(page);
+
+		int size = std::min(ATLAS_MIN_SIZE, atlas_size);
+
+		while (size < cell_w or size < cell_h)
+			size = std::min(size * 2, atlas_size);
+
+		textures.emplace_back(parent, size, size, SDL_TEXTUREACCESS_STATIC);
+		page = {&textures.back(), 0, 0, 0};
+	}
+
+	// move to next shelf
+	if (page.x + cell_w > page.texture->getWidth()) {
+		page.x = 0;
+		page.y += page.shelf_height;
+		page.shelf_height = 0;
+	}
+
+	SDL_Rect source = {page.x + 1, page.y + 1, surface->w, surface->h};
+
+	page.texture->update(surface, source);
+	if (std::find(pending.begin(), pending.end(), page.texture) == pending.end())
+		pending.push_back(page.texture);
+
+	page.x += cell_w;
+	page.shelf_height = std::max(page.shelf_height, cell_h);
+
+	ALPHA alpha = classifyAlpha(surface);
+	SDL_Color average = averageColor(surface);
+
+	SDL_FreeSurface(surface);
+
+	textures.emplace_back(page.texture, source, path, alpha, hash, average);
+
+	/*
+	 * on a true hash collision keep the older entry,
+	 * unless its page no longer has pixels to compare with
+	 */
+	if (found == hashes.end() or not found->second->getAtlas()->hasShadow())
+		hashes[hash] = &textures.back();
+
+	return &textures.back();
+}
+
+RenderItem::RenderItem(const TextureAccess &texture, int pos_x, int pos_y, bool flip_vert, bool flip_horz, int layer, bool overlay, COLOR color) :
+	texture(texture()),
+	pos_x(pos_x),
+	pos_y(pos_y),
+	layer(layer),
+	flip_vert(flip_vert),
+	flip_horz(flip_horz),
+	overlay(overlay),
+	lod(0),
+	color(color),
+	opacity(255)
+{}
+
+// cheap to queue by the thousand
+static_assert(std::is_trivially_copyable_v<RenderItem>);
+
+/*
+void RenderItem::setTexture(TextureAccess texture)
+{
+        this->texture = texture;
+}
+*/
+
+void RenderItem::setX(int pos_x)
+{
+	this->pos_x = pos_x;
+}
+
+void RenderItem::setY(int pos_y)
+{
+	this->pos_y = pos_y;
+}
+
+void RenderItem::setLayer(int layer)
+{
+	this->layer = layer;
+}
+
+void RenderItem::setLod(int lod)
+{
+	this->lod = lod;
+}
+
+void RenderItem::setOpacity(int opacity)
+{
+	this->opacity = opacity;
+}
+
+Texture *RenderItem::getTexture() const
+{
+	return texture;
+}
+
+const SDL_Rect *RenderItem::getSource() const
+{
+	return texture ? texture->getSource() : nullptr;
+}
+
+int RenderItem::getX() const
+{
+	return pos_x;
+}
+
+int RenderItem::getY() const
 {
 	return pos_y;
 }
@@ -306,75 +1084,302 @@ bool RenderItem::getOverlay() const
 	return overlay;
 }
 
-auto RenderItem::operator<=>(const RenderItem &other) const
+int RenderItem::getLod() const
 {
-	if (layer == other.layer)
-		return std::strong_ordering::equal;
-	else if (layer < other.layer)
-		return std::strong_ordering::less;
-	return std::strong_ordering::greater;
+	return lod;
 }
 
-/*
-bool RenderItem::operator<(const RenderItem &other) const
+COLOR RenderItem::getColor() const
 {
-	return layer < other.layer;
+	return color;
 }
 
-bool RenderItem::operator>(const RenderItem &other) const
+int RenderItem::getOpacity() const
 {
-	return layer > other.layer;
+	return opacity;
 }
-*/
 
-Renderer::Renderer() :
-	center_x(0),
-	center_y(0)
+RenderQueue::RenderQueue()
+{}
+
+void RenderQueue::push(const RenderItem &item)
 {
-	window = SDL_CreateWindow(
-	                 "Object Oriented Quest",
-	                 SDL_WINDOWPOS_UNDEFINED,
-	                 SDL_WINDOWPOS_UNDEFINED,
-	                 800,
-	                 600,
-	                 SDL_WINDOW_RESIZABLE
-	         );
+	size_t layer = std::max(item.getLayer(), 0);
 
-	if (not window)
-		throw std::runtime_error(SDL_GetError());
+	if (layer >= layers.size())
+		layers.resize(layer + 1);
 
-	renderer = SDL_CreateRenderer(
-	                   window,
-	                   -1,
-	                   SDL_RENDERER_ACCELERATED |
-	                   SDL_RENDERER_PRESENTVSYNC //|
-	                   //SDL_RENDERER_TARGETTEXTURE
-	           );
+	layers[layer].push_back(item);
+}
 
-	if (not renderer)
-		throw std::runtime_error(SDL_GetError());
+void RenderQueue::setBatching(int layer, bool batching)
+{
+	if (layer < 0)
+		return;
 
-	SDL_Surface *surface = IMG_Load("data/logo/WSS.png");
-	if (not surface)
-		throw std::runtime_error(IMG_GetError());
+	if (static_cast<size_t>(layer) >= this->batching.size())
+		this->batching.resize(layer + 1, false);
 
-	SDL_SetWindowIcon(window, surface);
-	SDL_FreeSurface(surface);
+	this->batching[layer] = batching;
+}
+
+int RenderQueue::getLayerCount() const
+{
+	return layers.size();
+}
+
+const std::vector<RenderItem> &RenderQueue::getLayer(int layer) const
+{
+	return layers[layer];
+}
+
+// what an item is drawn from, software images only have their bitmap
+static const void *getPixels(const RenderItem &item)
+{
+	Texture *texture = item.getTexture();
+
+	if (not texture)
+		return nullptr;
+
+	if (texture->getTexture())
+		return texture->getTexture();
+
+	return texture->getBitmap();
+}
+
+void RenderQueue::sort()
+{
+	/*
+	 * group items by texture to minimise binds
+	 * only on layers where draw order does not matter
+	 */
+	for (size_t i = 0; i < std::min(layers.size(), batching.size()); ++i) {
+		if (not batching[i])
+			continue;
+
+		std::sort(
+			layers[i].begin(), layers[i].end(),
+			[](const RenderItem &a, const RenderItem &b) {
+				return std::less<const void *>()(getPixels(a), getPixels(b));
+			}
+		);
+	}
+}
+
+void RenderQueue::clear()
+{
+	// keep capacity for next frame
+	for (auto &layer : layers)
+		layer.clear();
+}
+
+GlyphAtlas::GlyphAtlas(Renderer *parent) :
+	parent(parent),
+	texture_manager(parent->getTextureManager())
+{
+	// printable ascii up front, anything else on first use
+	for (uint32_t c = ' '; c <= '~'; ++c)
+		getGlyph(c);
+}
+
+int GlyphAtlas::addText(const std::string &text, int pos_x, int pos_y, int layer, COLOR color, bool overlay, std::vector<RenderItem> *items)
+{
+	/*
+	 * returns the width of the drawn text
+	 * glyphs go to items instead of the renderer if given
+	 */
+	int x = pos_x;
+
+	for (size_t i = 0; i < text.size();) {
+		// decode one utf-8 codepoint
+		auto c = static_cast<unsigned char>(text[i]);
+		uint32_t codepoint = c;
+		int length = 1;
+
+		if (c >= 0xF0)
+			length = 4, codepoint = c & 0x07;
+		else if (c >= 0xE0)
+			length = 3, codepoint = c & 0x0F;
+		else if (c >= 0xC0)
+			length = 2, codepoint = c & 0x1F;
+
+		for (int j = 1; j < length and i + j < text.size(); ++j)
+			codepoint = (codepoint << 6) | (text[i + j] & 0x3F);
+
+		i += length;
+
+		GLYPH &glyph = getGlyph(codepoint);
+
+		if (items)
+			items->emplace_back(glyph.texture, x, pos_y, false, false, layer, overlay, color);
+		else
+			parent->addRenderItem(glyph.texture, x, pos_y, false, false, layer, overlay, color);
+
+		x += glyph.advance;
+	}
 
+	return x - pos_x;
+}
+
+GlyphAtlas::GLYPH &GlyphAtlas::getGlyph(uint32_t codepoint)
+{
+	auto found = glyphs.find(codepoint);
+	if (found != glyphs.end())
+		return found->second;
+
+	// encode back to utf-8 for SDL_ttf
+	std::string text;
+
+	if (codepoint < 0x80) {
+		text += static_cast<char>(codepoint);
+	} else if (codepoint < 0x800) {
+		text += static_cast<char>(0xC0 | (codepoint >> 6));
+		text += static_cast<char>(0x80 | (codepoint & 0x3F));
+	} else if (codepoint < 0x10000) {
+		text += static_cast<char>(0xE0 | (codepoint >> 12));
+		text += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+		text += static_cast<char>(0x80 | (codepoint & 0x3F));
+	} else {
+		text += static_cast<char>(0xF0 | (codepoint >> 18));
+		text += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+		text += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+		text += static_cast<char>(0x80 | (codepoint & 0x3F));
+	}
+
+	GLYPH glyph = {TextureAccess(), 0};
+
+	// rasterise in white, colour comes from modulation
+	SDL_Surface *surface = TTF_RenderUTF8_Solid(
+			parent->getFont(),
+			text.c_str(),
+			getColor(WHITE)
+		);
+
+	if (surface) {
+		glyph.texture = texture_manager->packGlyph(surface);
+		glyph.advance = surface->w;
+		SDL_FreeSurface(surface);
+	} else {
+		// nothing to draw, still take up space
+		TTF_SizeUTF8(parent->getFont(), text.c_str(), &glyph.advance, NULL);
+	}
+
+	return glyphs[codepoint] = glyph;
+}
+
+Renderer::Renderer(int flags) :
+	offscreen(nullptr),
+	assets(new AssetPack(std::filesystem::path(OOQ_BUILD_DIR) / PACK_FILE)),
+	texture_cache(nullptr),
+	flags(flags),
+	width(0),
+	height(0),
+	capture(nullptr),
+	readback_ready(false),
+	target(nullptr),
+	clip({0, 0, 0, 0}),
+	clipped(false),
+	viewports(1, {{0, 0, 0, 0}, 0, 0, 0}),
+	target_generation(0)
+{
+	if (flags & RENDER_HEADLESS) {
+		/*
+		 * draw into a plain surface, no display needed
+		 * textures, targets and the queue work as usual
+		 * and nothing waits for vsync
+		 */
+		window = nullptr;
+		offscreen = SDL_CreateRGBSurfaceWithFormat(0, 800, 600, 32, SDL_PIXELFORMAT_RGBA32);
+
+		if (not offscreen)
+			throw std::runtime_error(SDL_GetError());
+
+		renderer = SDL_CreateSoftwareRenderer(offscreen);
+
+		if (not renderer)
+			throw std::runtime_error(SDL_GetError());
+	} else {
+		window = SDL_CreateWindow(
+		                 "Object Oriented Quest",
+		                 SDL_WINDOWPOS_UNDEFINED,
+		                 SDL_WINDOWPOS_UNDEFINED,
+		                 800,
+		                 600,
+		                 SDL_WINDOW_RESIZABLE
+		         );
+
+		if (not window)
+			throw std::runtime_error(SDL_GetError());
+
+		renderer = SDL_CreateRenderer(
+		                   window,
+		                   -1,
+		                   (flags & RENDER_SOFTWARE ? SDL_RENDERER_SOFTWARE : SDL_RENDERER_ACCELERATED) |
+		                   SDL_RENDERER_PRESENTVSYNC |
+		                   SDL_RENDERER_TARGETTEXTURE
+		           );
+
+		if (not renderer)
+			throw std::runtime_error(SDL_GetError());
+
+		SDL_Surface *surface = IMG_Load_RW(assets->open("data/logo/WSS.png"), 1);
+		if (not surface)
+			throw std::runtime_error(IMG_GetError());
+
+		SDL_SetWindowIcon(window, surface);
+		SDL_FreeSurface(surface);
+	}
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	// bitmaps are blitted one by one, there is nothing to batch
+	if (flags & RENDER_SOFTWARE)
+		geometry = false;
+#endif
+
+	// decoded images are kept next to the minimap cache
+	std::filesystem::path cache_path;
+	char *pref = SDL_GetPrefPath("", "OOQ");
+
+	if (pref) {
+		cache_path = std::filesystem::path(pref) / "textures.cache";
+		SDL_free(pref);
+	}
+
+	texture_cache = new TextureCache(cache_path, assets);
 	texture_manager = new TextureManager(this);
 
-	font = TTF_OpenFont("data/font/Hack-Regular.ttf", 10);
+	font = TTF_OpenFontRW(assets->open("data/font/Hack-Regular.ttf"), 1, 10);
 
 	if (not font)
 		throw std::runtime_error(TTF_GetError());
+
+	glyph_atlas = new GlyphAtlas(this);
 }
 
 Renderer::~Renderer()
 {
+	// the last frame is still waiting to be read back
+	if (capture and readback_ready)
+		readBack();
+
+	// waits for queued frames to be written
+	delete capture;
+
+	readback = TextureAccess();
+	frame = TextureAccess();
+	delete glyph_atlas;
 	TTF_CloseFont(font);
 	delete texture_manager;
+	// written out now that every image is loaded
+	delete texture_cache;
+	delete assets;
 	SDL_DestroyRenderer(renderer);
-	SDL_DestroyWindow(window);
+
+	if (window)
+		SDL_DestroyWindow(window);
+
+	if (offscreen)
+		SDL_FreeSurface(offscreen);
 }
 
 SDL_Renderer *Renderer::getRenderer()
@@ -387,21 +1392,136 @@ TextureManager *Renderer::getTextureManager()
 	return texture_manager;
 }
 
+AssetPack *Renderer::getAssets()
+{
+	return assets;
+}
+
+TextureCache *Renderer::getTextureCache()
+{
+	return texture_cache;
+}
+
 TTF_Font *Renderer::getFont()
 {
 	return font;
 }
 
+bool Renderer::isSoftware()
+{
+	return flags & RENDER_SOFTWARE;
+}
+
+bool Renderer::isHeadless()
+{
+	return flags & RENDER_HEADLESS;
+}
+
+void Renderer::startCapture(std::filesystem::path directory, CAPTURE_FORMAT format)
+{
+	delete capture;
+	capture = new FrameCapture(directory, format);
+}
+
 void Renderer::setSize(int width, int height)
 {
-	if (SDL_RenderSetLogicalSize(renderer, width, height))
-		throw std::runtime_error(SDL_GetError());
+	this->width = width;
+	this->height = height;
+
+	layoutViewports();
+
+	if (not (flags & RENDER_INTEGER_SCALE)) {
+		// let SDL scale every copy
+		if (SDL_RenderSetLogicalSize(renderer, width, height))
+			throw std::runtime_error(SDL_GetError());
+
+		if (not (flags & RENDER_SOFTWARE) and not capture)
+			return;
+	}
+
+	// draw into a native size frame, scaled once in present()
+	frame = texture_manager->makeFrame(width, height);
+	frame()->setBlendMode(SDL_BLENDMODE_NONE);
+#if SDL_VERSION_ATLEAST(2, 0, 12)
+	SDL_SetTextureScaleMode(frame()->getTexture(), SDL_ScaleModeNearest);
+#endif
+
+	if (not capture or flags & RENDER_SOFTWARE)
+		return;
+
+	// frames of the old size are not read back
+	readback = texture_manager->makeTarget(width, height);
+	readback_ready = false;
+	readback()->setBlendMode(SDL_BLENDMODE_NONE);
+}
+
+void Renderer::getSize(int *width, int *height)
+{
+	*width = this->width;
+	*height = this->height;
+}
+
+void Renderer::setCenter(int x, int y, int viewport)
+{
+	viewports[viewport].center_x = x;
+	viewports[viewport].center_y = y;
 }
 
-void Renderer::setCenter(int x, int y)
+void Renderer::setLayerBatching(int layer, bool batching)
 {
-	center_x = x;
-	center_y = y;
+	render_queue.setBatching(layer, batching);
+}
+
+void Renderer::setViewportCount(int count)
+{
+	count = std::max(count, 1);
+
+	if (static_cast<size_t>(count) == viewports.size())
+		return;
+
+	viewports.resize(count, viewports.back());
+	layoutViewports();
+}
+
+int Renderer::getViewportCount()
+{
+	return viewports.size();
+}
+
+void Renderer::setZoom(int zoom, int viewport)
+{
+	viewports[viewport].zoom = zoom;
+}
+
+int Renderer::getZoom(int viewport)
+{
+	return viewports[viewport].zoom;
+}
+
+void Renderer::getView(int *x, int *y, int *w, int *h, int viewport)
+{
+	// visible area in map pixels, same math as operator()
+	const VIEWPORT &view = viewports[viewport];
+
+	*w = view.rect.w << view.zoom;
+	*h = view.rect.h << view.zoom;
+	*x = view.center_x - *w / 2;
+	*y = view.center_y - *h / 2;
+}
+
+bool Renderer::isVisible(int x, int y, int w, int h)
+{
+	// true if any viewport shows part of the rectangle
+	for (size_t i = 0; i < viewports.size(); ++i) {
+		int view_x, view_y, view_w, view_h;
+		getView(&view_x, &view_y, &view_w, &view_h, i);
+
+		if (x < view_x + view_w and x + w > view_x and
+		    y < view_y + view_h and y + h > view_y)
+			return true;
+	}
+
+	return false;
 }
 
 void Renderer::addRenderItem(const RenderItem &item)
@@ -409,54 +1529,459 @@ void Renderer::addRenderItem(const RenderItem &item)
 	render_queue.push(item);
 }
 
-void Renderer::addRenderItem(TextureAccess texture, int pos_x, int pos_y, bool flip_vert, bool flip_horz, int layer, bool overlay)
+void Renderer::addRenderItem(const TextureAccess &texture, int pos_x, int pos_y, bool flip_vert, bool flip_horz, int layer, bool overlay, COLOR color)
 {
-	render_queue.emplace(texture, pos_x, pos_y, flip_vert, flip_horz, layer, overlay);
+	render_queue.push(RenderItem(texture, pos_x, pos_y, flip_vert, flip_horz, layer, overlay, color));
+}
+
+void Renderer::addRenderItems(const std::vector<RenderItem> &items, int offset_x, int offset_y, int layer)
+{
+	for (auto item : items) {
+		item.setX(item.getX() + offset_x);
+		item.setY(item.getY() + offset_y);
+		item.setLayer(layer);
+		render_queue.push(item);
+	}
+}
+
+int Renderer::addText(const std::string &text, int pos_x, int pos_y, int layer, COLOR color, bool overlay)
+{
+	return glyph_atlas->addText(text, pos_x, pos_y, layer, color, overlay);
+}
+
+int Renderer::layoutText(const std::string &text, int pos_x, int pos_y, COLOR color, std::vector<RenderItem> &items)
+{
+	// overlay glyphs for later use with addRenderItems
+	return glyph_atlas->addText(text, pos_x, pos_y, 0, color, true, &items);
+}
+
+void Renderer::renderToTexture(TextureAccess target, const std::vector<RenderItem> &items, SDL_BlendMode blend_mode, int zoom, bool clear)
+{
+	/*
+	 * draw items straight into a render target
+	 * item positions are relative to its top left corner
+	 * without clear the items go on top of what is there
+	 */
+	if (not target())
+		return;
+
+	// items may use freshly packed glyphs or tiles
+	texture_manager->updateAtlas();
+
+	Texture *old_target = this->target;
+
+	setTarget(target());
+
+	if (clear)
+		this->clear();
+
+	for (auto &item : items) {
+		Texture *tex = item.getTexture();
+
+		if (not tex)
+			continue;
+
+		// textures may be shared, restore their mode afterwards
+		SDL_BlendMode old_mode = tex->getBlendMode();
+		tex->setBlendMode(blend_mode);
+
+		draw(item, place(item, 0, 0, zoom));
+
+		tex->setBlendMode(old_mode);
+	}
+
+	setTarget(old_target);
+}
+
+void Renderer::restoreTextures()
+{
+	// the device was reset, targets are redrawn after this
+	texture_manager->restore();
+}
+
+void Renderer::invalidateTargets()
+{
+	++target_generation;
+	// the copy of the last frame went with the device
+	readback_ready = false;
+}
+
+unsigned long Renderer::getTargetGeneration()
+{
+	return target_generation;
 }
 
 void Renderer::operator()()
 {
-	int screen_width, screen_height;
+	// push freshly packed tiles to the gpu
+	texture_manager->updateAtlas();
+
+	// last frame's copy had a whole frame to finish on the gpu
+	if (capture and readback_ready)
+		readBack();
+
+	setTarget(frame());
+	clear();
+
+	render_queue.sort();
+
+	/*
+	 * map items are drawn once per viewport, clipped to it
+	 * overlay items once on top of every layer
+	 */
+	bool split = viewports.size() > 1;
+
+	for (int layer = 0; layer < render_queue.getLayerCount(); ++layer) {
+		auto &items = render_queue.getLayer(layer);
+
+		for (size_t i = 0; i < viewports.size(); ++i) {
+			int view_x, view_y, view_w, view_h;
+			getView(&view_x, &view_y, &view_w, &view_h, i);
+
+			int zoom = viewports[i].zoom;
+			int offset_x = viewports[i].rect.x - (view_x >> zoom);
+			int offset_y = viewports[i].rect.y - (view_y >> zoom);
+
+			if (split) {
+				flush();
+				setClip(&viewports[i].rect);
+			}
+
+			for (auto &render_item : items) {
+				if (render_item.getOverlay())
+					continue;
+
+				// items culled for the other viewport
+				Texture *tex = render_item.getTexture();
+				if (split and tex and not (
+					    render_item.getX() < view_x + view_w and
+					    render_item.getX() + (tex->getWidth() << render_item.getLod()) > view_x and
+					    render_item.getY() < view_y + view_h and
+					    render_item.getY() + (tex->getHeight() << render_item.getLod()) > view_y
+				    ))
+					continue;
+
+				batch(render_item, offset_x, offset_y, zoom);
+			}
+		}
+
+		if (split) {
+			flush();
+			setClip(NULL);
+		}
+
+		for (auto &render_item : items)
+			if (render_item.getOverlay())
+				batch(render_item, 0, 0);
+	}
+
+	flush();
+	render_queue.clear();
+
+	if (capture)
+		grab();
+
+	present();
+}
+
+void Renderer::grab()
+{
+	if (not (flags & RENDER_SOFTWARE)) {
+		/*
+		 * reading the frame just drawn would wait for the gpu to finish it
+		 * keep a copy instead and read that back next frame
+		 * the read itself is still synchronous, SDL has no async readback
+		 */
+		uint64_t start = SDL_GetPerformanceCounter();
+		setTarget(readback());
+
+		if (SDL_RenderCopy(renderer, frame()->getTexture(), NULL, NULL))
+			throw std::runtime_error(SDL_GetError());
+
+		readback_ready = true;
+		capture->addOverhead(SDL_GetPerformanceCounter() - start);
+		return;
+	}
+
+	/*
+	 * copy the finished native frame into a capture buffer
+	 * the writer thread takes it from there
+	 */
+	uint8_t *pixels = capture->begin(width, height);
 
-	SDL_RenderGetLogicalSize(renderer, &screen_width, &screen_height);
+	if (not pixels)
+		return;
+
+	Bitmap *bitmap = frame()->getBitmap();
+
+	for (int y = 0; y < height; ++y)
+		std::memcpy(pixels + y * width * 4, bitmap->getRow(y), width * 4);
+
+	capture->end();
+}
+
+void Renderer::readBack()
+{
+	// the copy made by grab() last frame
+	readback_ready = false;
+	uint8_t *pixels = capture->begin(width, height);
+
+	if (not pixels)
+		return;
+
+	setTarget(readback());
+
+	if (SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_RGBA32, pixels, width * 4))
+		throw std::runtime_error(SDL_GetError());
+
+	capture->end();
+}
+
+void Renderer::present()
+{
+	if (not frame()) {
+		SDL_RenderPresent(renderer);
+		return;
+	}
+
+	/*
+	 * one nearest neighbour upscale of the whole frame
+	 * by the largest integer factor that fits, letterboxed
+	 */
+	SDL_SetRenderTarget(renderer, NULL);
 	SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0x00);
 	SDL_RenderClear(renderer);
 
-	while (!render_queue.empty()) {
-		auto render_item = render_queue.top();
-		auto tex = render_item.getTexture();
-
-		if (tex()) {
-			SDL_Rect pos;
-			if (not render_item.getOverlay())
-				pos = {
-					.x = render_item.getX()
-			     	     	     - center_x + screen_width / 2,
-					.y = render_item.getY()
-			     	             - center_y + screen_height / 2,
-					.w = tex()->getWidth(),
-					.h = tex()->getHeight()
-				};
-			else
-				pos = {
-					.x = render_item.getX(),
-					.y = render_item.getY(),
-					.w = tex()->getWidth(),
-					.h = tex()->getHeight()
-				};
-
-			SDL_RendererFlip flip = static_cast<SDL_RendererFlip>(
-				(SDL_FLIP_VERTICAL and 
-				 render_item.getFlipVert()) |
-				(SDL_FLIP_VERTICAL and
-				 render_item.getFlipHorz())
-			);
+	if (flags & RENDER_SOFTWARE) {
+		// the only upload of the frame
+		Bitmap *bitmap = frame()->getBitmap();
 
-			SDL_RenderCopyEx(renderer, tex()->getTexture(), NULL, &pos, 0, NULL, flip);
-		}
+		SDL_UpdateTexture(
+			frame()->getTexture(), NULL,
+			bitmap->getPixels(), bitmap->getPitch() * sizeof(uint32_t)
+		);
+	}
 
-		render_queue.pop();
+	// logical size does the scaling
+	if (not (flags & RENDER_INTEGER_SCALE)) {
+		SDL_RenderCopy(renderer, frame()->getTexture(), NULL, NULL);
+		SDL_RenderPresent(renderer);
+		return;
 	}
 
+	int output_width, output_height;
+	SDL_GetRendererOutputSize(renderer, &output_width, &output_height);
+
+	int scale = std::min(output_width / width, output_height / height);
+	SDL_Rect pos;
+
+	if (scale >= 1) {
+		pos.w = width * scale;
+		pos.h = height * scale;
+	} else {
+		// window smaller than the frame, shrink keeping aspect
+		pos.w = std::min(output_width, output_height * width / height);
+		pos.h = std::min(output_height, output_width * height / width);
+	}
+
+	pos.x = (output_width - pos.w) / 2;
+	pos.y = (output_height - pos.h) / 2;
+
+	SDL_RenderCopy(renderer, frame()->getTexture(), NULL, &pos);
 	SDL_RenderPresent(renderer);
 }
+
+SDL_Rect Renderer::place(const RenderItem &item, int offset_x, int offset_y, int zoom)
+{
+	/*
+	 * screen rectangle of an item
+	 * positions are shrunk before the offset is added
+	 * so neighbouring chunks still meet exactly
+	 */
+	Texture *tex = item.getTexture();
+
+	return {
+		.x = (item.getX() >> zoom) + offset_x,
+		.y = (item.getY() >> zoom) + offset_y,
+		.w = (tex->getWidth() << item.getLod()) >> zoom,
+		.h = (tex->getHeight() << item.getLod()) >> zoom
+	};
+}
+
+void Renderer::batch(const RenderItem &item, int offset_x, int offset_y, int zoom)
+{
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	/*
+	 * consecutive items sharing a texture
+	 * become one SDL_RenderGeometry call
+	 */
+	Texture *tex = item.getTexture();
+
+	if (not tex)
+		return;
+
+	SDL_Rect pos = place(item, offset_x, offset_y, zoom);
+
+	if (not geometry) {
+		draw(item, pos);
+		return;
+	}
+
+	if (tex->getTexture() != batch_texture) {
+		flush();
+		batch_texture = tex->getTexture();
+	}
+
+	const SDL_Rect *source = tex->getSource();
+	int texture_width, texture_height;
+	tex->getTextureSize(&texture_width, &texture_height);
+
+	float x0 = pos.x;
+	float y0 = pos.y;
+	float x1 = pos.x + pos.w;
+	float y1 = pos.y + pos.h;
+
+	float u0 = static_cast<float>(source->x) / texture_width;
+	float v0 = static_cast<float>(source->y) / texture_height;
+	float u1 = static_cast<float>(source->x + source->w) / texture_width;
+	float v1 = static_cast<float>(source->y + source->h) / texture_height;
+
+	SDL_RendererFlip flip = getFlip(item);
+
+	if (flip & SDL_FLIP_HORIZONTAL)
+		std::swap(u0, u1);
+
+	if (flip & SDL_FLIP_VERTICAL)
+		std::swap(v0, v1);
+
+	// colour goes per vertex so it does not break the batch
+	SDL_Color color = getColor(item.getColor());
+	color.a = item.getOpacity();
+	int base = vertices.size();
+
+	vertices.push_back({{x0, y0}, color, {u0, v0}});
+	vertices.push_back({{x1, y0}, color, {u1, v0}});
+	vertices.push_back({{x1, y1}, color, {u1, v1}});
+	vertices.push_back({{x0, y1}, color, {u0, v1}});
+
+	for (int i : {0, 1, 2, 0, 2, 3})
+		indices.push_back(base + i);
+
+	// kept for the fallback path
+	batch_items.emplace_back(item, pos);
+#else
+	if (item.getTexture())
+		draw(item, place(item, offset_x, offset_y, zoom));
+#endif
+}
+
+void Renderer::flush()
+{
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	if (vertices.empty())
+		return;
+
+	if (SDL_RenderGeometry(
+		    renderer, batch_texture,
+		    vertices.data(), vertices.size(),
+		    indices.data(), indices.size()
+	    )) {
+		// backend cannot do geometry, stay on plain copies
+		geometry = false;
+
+		for (auto &[item, pos] : batch_items)
+			draw(item, pos);
+	}
+
+	vertices.clear();
+	indices.clear();
+	batch_items.clear();
+	batch_texture = nullptr;
+#endif
+}
+
+void Renderer::setTarget(Texture *target)
+{
+	this->target = target;
+
+	if (flags & RENDER_SOFTWARE)
+		return;
+
+	if (SDL_SetRenderTarget(renderer, target ? target->getTexture() : NULL))
+		throw std::runtime_error(SDL_GetError());
+}
+
+void Renderer::setClip(const SDL_Rect *rect)
+{
+	if (not (flags & RENDER_SOFTWARE)) {
+		SDL_RenderSetClipRect(renderer, rect);
+		return;
+	}
+
+	clipped = rect;
+
+	if (rect)
+		clip = *rect;
+}
+
+void Renderer::clear()
+{
+	if (flags & RENDER_SOFTWARE) {
+		target->getBitmap()->clear();
+		return;
+	}
+
+	SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0x00);
+	SDL_RenderClear(renderer);
+}
+
+void Renderer::layoutViewports()
+{
+	// equal columns across the screen
+	int count = viewports.size();
+
+	for (int i = 0; i < count; ++i) {
+		int left = i * width / count;
+		int right = (i + 1) * width / count;
+
+		viewports[i].rect = {left, 0, right - left, height};
+	}
+}
+
+void Renderer::draw(const RenderItem &item, const SDL_Rect &pos)
+{
+	Texture *tex = item.getTexture();
+
+	SDL_RendererFlip flip = getFlip(item);
+
+	if (flags & RENDER_SOFTWARE) {
+		// same blend mode bookkeeping as the SDL path
+		BLIT blit_mode = tex->getBlendMode() == SDL_BLENDMODE_NONE or
+			(tex->getAlpha() == ALPHA_OPAQUE and item.getOpacity() == 255) ?
+			BLIT_COPY : BLIT_BLEND;
+
+		SDL_Color color = getColor(item.getColor());
+		color.a = item.getOpacity();
+
+		blit(
+			target->getBitmap(), clipped ? &clip : nullptr,
+			tex->getBitmap(), tex->getSource(), &pos,
+			flip, blit_mode, color
+		);
+		return;
+	}
+
+	if (item.getColor() == WHITE and item.getOpacity() == 255) {
+		SDL_RenderCopyEx(renderer, tex->getTexture(), item.getSource(), &pos, 0, NULL, flip);
+		return;
+	}
+
+	// shared pages go back to unmodulated after the copy
+	SDL_Color color = getColor(item.getColor());
+
+	SDL_SetTextureColorMod(tex->getTexture(), color.r, color.g, color.b);
+	SDL_SetTextureAlphaMod(tex->getTexture(), item.getOpacity());
+	SDL_RenderCopyEx(renderer, tex->getTexture(), item.getSource(), &pos, 0, NULL, flip);
+	SDL_SetTextureColorMod(tex->getTexture(), 255, 255, 255);
+	SDL_SetTextureAlphaMod(tex->getTexture(), 255);
+}
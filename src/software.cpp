@@ -0,0 +1,413 @@
+#include "software.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#ifdef __unix__
+#include <SDL2/SDL.h>
+#elif _WIN32
+#include <ciso646>
+#include <SDL.h>
+#else
+#error Unsupported platform
+#endif
+
+// x86 builds always have SSE2, AVX2 is checked at runtime
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFTWARE_SIMD
+#include <immintrin.h>
+
+#if defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+#endif
+
+// row of count pixels, src is walked backwards when reverse is set
+typedef void (*ROW_KERNEL)(uint32_t *dst, const uint32_t *src, int count, bool reverse);
+
+static inline uint32_t blendPixel(uint32_t dst, uint32_t src)
+{
+	/*
+	 * RGBA32 is R, G, B, A in memory on every platform
+	 * out = src * a + dst * (1 - a), alpha = a + dst_a * (1 - a)
+	 */
+	uint8_t s[4], d[4];
+	std::memcpy(s, &src, sizeof(s));
+
+	int a = s[3];
+
+	if (a == 255)
+		return src;
+
+	if (a == 0)
+		return dst;
+
+	std::memcpy(d, &dst, sizeof(d));
+	s[3] = 255;
+
+	for (int c = 0; c < 4; ++c) {
+		int x = s[c] * a + d[c] * (255 - a) + 128;
+		d[c] = (x + (x >> 8)) >> 8;
+	}
+
+	std::memcpy(&dst, d, sizeof(dst));
+	return dst;
+}
+
+static void copyRowScalar(uint32_t *dst, const uint32_t *src, int count, bool reverse)
+{
+	if (not reverse) {
+		std::memcpy(dst, src, count * sizeof(uint32_t));
+		return;
+	}
+
+	for (int i = 0; i < count; ++i)
+		dst[i] = src[count - 1 - i];
+}
+
+static void blendRowScalar(uint32_t *dst, const uint32_t *src, int count, bool reverse)
+{
+	for (int i = 0; i < count; ++i)
+		dst[i] = blendPixel(dst[i], src[reverse ? count - 1 - i : i]);
+}
+
+#ifdef SOFTWARE_SIMD
+/*
+ * the SIMD kernels assume little endian RGBA32
+ * which puts alpha in the top byte of every pixel
+ */
+
+static inline __m128i reverseSSE2(__m128i v)
+{
+	return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+static inline __m128i blendHalfSSE2(__m128i s, __m128i d, __m128i a)
+{
+	// two pixels widened to 16 bit channels, a holds their alpha per channel
+	__m128i x = _mm_add_epi16(
+		_mm_mullo_epi16(s, a),
+		_mm_mullo_epi16(d, _mm_sub_epi16(_mm_set1_epi16(255), a))
+	);
+
+	// divide by 255 with rounding
+	x = _mm_add_epi16(x, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+static void copyRowSSE2(uint32_t *dst, const uint32_t *src, int count, bool reverse)
+{
+	if (not reverse) {
+		std::memcpy(dst, src, count * sizeof(uint32_t));
+		return;
+	}
+
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + count - 4 - i));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), reverseSSE2(s));
+	}
+
+	for (; i < count; ++i)
+		dst[i] = src[count - 1 - i];
+}
+
+static void blendRowSSE2(uint32_t *dst, const uint32_t *src, int count, bool reverse)
+{
+	const __m128i alpha_mask = _mm_set1_epi32(0xFF000000);
+	const __m128i zero = _mm_setzero_si128();
+
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i s = reverse ?
+			reverseSSE2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + count - 4 - i))) :
+			_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+		__m128i alpha = _mm_and_si128(s, alpha_mask);
+
+		// alpha tested sprites and tiles are nearly always one of these
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alpha_mask)) == 0xFFFF) {
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), s);
+			continue;
+		}
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero)) == 0xFFFF)
+			continue;
+
+		__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+
+		// alpha of every pixel in both 16 bit halves of its lane
+		__m128i a = _mm_srli_epi32(s, 24);
+		a = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+
+		// blend with the source alpha channel as 255, see blendPixel
+		s = _mm_or_si128(s, alpha_mask);
+
+		__m128i lo = blendHalfSSE2(
+			_mm_unpacklo_epi8(s, zero),
+			_mm_unpacklo_epi8(d, zero),
+			_mm_unpacklo_epi32(a, a)
+		);
+		__m128i hi = blendHalfSSE2(
+			_mm_unpackhi_epi8(s, zero),
+			_mm_unpackhi_epi8(d, zero),
+			_mm_unpackhi_epi32(a, a)
+		);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(lo, hi));
+	}
+
+	for (; i < count; ++i)
+		dst[i] = blendPixel(dst[i], src[reverse ? count - 1 - i : i]);
+}
+
+TARGET_AVX2 static inline __m256i reverseAVX2(__m256i v)
+{
+	return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+}
+
+TARGET_AVX2 static inline __m256i blendHalfAVX2(__m256i s, __m256i d, __m256i a)
+{
+	__m256i x = _mm256_add_epi16(
+		_mm256_mullo_epi16(s, a),
+		_mm256_mullo_epi16(d, _mm256_sub_epi16(_mm256_set1_epi16(255), a))
+	);
+
+	x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+TARGET_AVX2 static void copyRowAVX2(uint32_t *dst, const uint32_t *src, int count, bool reverse)
+{
+	if (not reverse) {
+		std::memcpy(dst, src, count * sizeof(uint32_t));
+		return;
+	}
+
+	int i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + count - 8 - i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), reverseAVX2(s));
+	}
+
+	for (; i < count; ++i)
+		dst[i] = src[count - 1 - i];
+}
+
+TARGET_AVX2 static void blendRowAVX2(uint32_t *dst, const uint32_t *src, int count, bool reverse)
+{
+	const __m256i alpha_mask = _mm256_set1_epi32(0xFF000000);
+	const __m256i zero = _mm256_setzero_si256();
+
+	int i = 0;
+
+	// unpack and pack stay inside 128 bit lanes, so pixel order survives
+	for (; i + 8 <= count; i += 8) {
+		__m256i s = reverse ?
+			reverseAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + count - 8 - i))) :
+			_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+		__m256i alpha = _mm256_and_si256(s, alpha_mask);
+
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, alpha_mask)) == -1) {
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), s);
+			continue;
+		}
+
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, zero)) == -1)
+			continue;
+
+		__m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+
+		__m256i a = _mm256_srli_epi32(s, 24);
+		a = _mm256_or_si256(a, _mm256_slli_epi32(a, 16));
+
+		s = _mm256_or_si256(s, alpha_mask);
+
+		__m256i lo = blendHalfAVX2(
+			_mm256_unpacklo_epi8(s, zero),
+			_mm256_unpacklo_epi8(d, zero),
+			_mm256_unpacklo_epi32(a, a)
+		);
+		__m256i hi = blendHalfAVX2(
+			_mm256_unpackhi_epi8(s, zero),
+			_mm256_unpackhi_epi8(d, zero),
+			_mm256_unpackhi_epi32(a, a)
+		);
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_packus_epi16(lo, hi));
+	}
+
+	for (; i < count; ++i)
+		dst[i] = blendPixel(dst[i], src[reverse ? count - 1 - i : i]);
+}
+#endif
+
+struct KERNELS {
+	ROW_KERNEL copy;
+	ROW_KERNEL blend;
+};
+
+static KERNELS pickKernels()
+{
+#ifdef SOFTWARE_SIMD
+	if (SDL_HasAVX2())
+		return {copyRowAVX2, blendRowAVX2};
+
+	return {copyRowSSE2, blendRowSSE2};
+#else
+	return {copyRowScalar, blendRowScalar};
+#endif
+}
+
+Bitmap::Bitmap(int width, int height) :
+	memory(nullptr),
+	pixels(nullptr),
+	width(width),
+	height(height),
+	pitch((width + 7) & ~7)
+{
+	// over allocate so the first row can be moved to an aligned address
+	size_t size = static_cast<size_t>(pitch) * height * sizeof(uint32_t);
+	memory = new uint8_t[size + 31]();
+
+	uintptr_t address = reinterpret_cast<uintptr_t>(memory);
+	pixels = reinterpret_cast<uint32_t *>((address + 31) & ~static_cast<uintptr_t>(31));
+}
+
+Bitmap::Bitmap(SDL_Surface *surface) :
+	Bitmap(surface->w, surface->h)
+{
+	SDL_Surface *converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+
+	if (!converted) {
+		delete[] memory;
+		throw std::runtime_error(SDL_GetError());
+	}
+
+	for (int y = 0; y < height; ++y)
+		std::memcpy(
+			getRow(y),
+			static_cast<uint8_t *>(converted->pixels) + y * converted->pitch,
+			width * sizeof(uint32_t)
+		);
+
+	SDL_FreeSurface(converted);
+}
+
+Bitmap::~Bitmap()
+{
+	delete[] memory;
+}
+
+void Bitmap::clear()
+{
+	std::memset(pixels, 0, static_cast<size_t>(pitch) * height * sizeof(uint32_t));
+}
+
+uint32_t *Bitmap::getPixels()
+{
+	return pixels;
+}
+
+uint32_t *Bitmap::getRow(int y)
+{
+	return pixels + static_cast<size_t>(y) * pitch;
+}
+
+int Bitmap::getWidth()
+{
+	return width;
+}
+
+int Bitmap::getHeight()
+{
+	return height;
+}
+
+int Bitmap::getPitch()
+{
+	return pitch;
+}
+
+void blit(Bitmap *dst, const SDL_Rect *clip, Bitmap *src, const SDL_Rect *source, const SDL_Rect *pos, SDL_RendererFlip flip, BLIT mode, SDL_Color color)
+{
+	static const KERNELS kernels = pickKernels();
+
+	SDL_Rect bounds = {0, 0, dst->getWidth(), dst->getHeight()};
+	SDL_Rect area;
+
+	if (clip and not SDL_IntersectRect(&bounds, clip, &bounds))
+		return;
+
+	if (not SDL_IntersectRect(pos, &bounds, &area))
+		return;
+
+	bool flip_horz = flip & SDL_FLIP_HORIZONTAL;
+	bool flip_vert = flip & SDL_FLIP_VERTICAL;
+	bool scaled = pos->w != source->w or pos->h != source->h;
+	bool tinted = color.r != 255 or color.g != 255 or color.b != 255 or color.a != 255;
+
+	if (not scaled and not tinted) {
+		// tiles and sprites, one kernel call per row
+		ROW_KERNEL kernel = mode == BLIT_COPY ? kernels.copy : kernels.blend;
+		int skip = area.x - pos->x;
+
+		for (int y = area.y; y < area.y + area.h; ++y) {
+			int src_y = y - pos->y;
+
+			if (flip_vert)
+				src_y = source->h - 1 - src_y;
+
+			const uint32_t *src_row = src->getRow(source->y + src_y) + source->x;
+
+			// a mirrored row starts where the visible part ends
+			if (flip_horz)
+				src_row += source->w - skip - area.w;
+			else
+				src_row += skip;
+
+			kernel(dst->getRow(y) + area.x, src_row, area.w, flip_horz);
+		}
+
+		return;
+	}
+
+	// nearest neighbour, with colour and alpha modulation
+	for (int y = area.y; y < area.y + area.h; ++y) {
+		int src_y = (y - pos->y) * source->h / pos->h;
+
+		if (flip_vert)
+			src_y = source->h - 1 - src_y;
+
+		const uint32_t *src_row = src->getRow(source->y + src_y) + source->x;
+		uint32_t *dst_row = dst->getRow(y);
+
+		for (int x = area.x; x < area.x + area.w; ++x) {
+			int src_x = (x - pos->x) * source->w / pos->w;
+
+			if (flip_horz)
+				src_x = source->w - 1 - src_x;
+
+			uint32_t pixel = src_row[src_x];
+
+			if (tinted) {
+				uint8_t channel[4];
+				std::memcpy(channel, &pixel, sizeof(channel));
+
+				channel[0] = channel[0] * color.r / 255;
+				channel[1] = channel[1] * color.g / 255;
+				channel[2] = channel[2] * color.b / 255;
+				channel[3] = channel[3] * color.a / 255;
+
+				std::memcpy(&pixel, channel, sizeof(pixel));
+			}
+
+			dst_row[x] = mode == BLIT_COPY ? pixel : blendPixel(dst_row[x], pixel);
+		}
+	}
+}
@@ -16,6 +16,255 @@
 #error Unsupported platform
 #endif
 
+TextBlock::TextBlock(Renderer *renderer) :
+	renderer(renderer),
+	max_char(0),
+	color(BLACK),
+	valid(false),
+	height(0)
+{}
+
+void TextBlock::set(const std::string &text, int max_char, COLOR color)
+{
+	if (valid and text == this->text and
+	    max_char == this->max_char and color == this->color)
+		return;
+
+	this->text = text;
+	this->max_char = max_char;
+	this->color = color;
+	valid = true;
+
+	// wrap into lines
+	std::vector<std::string> lines;
+	unsigned int begin = 0;
+	unsigned int end = 1;
+
+	while (end < text.size()) {
+		if (text[end] == ';' or end - begin + 1 >= max_char) {
+			lines.push_back(text.substr(begin, end - begin));
+
+			begin = end;
+
+			if (text[begin] == ';') {
+				++begin;
+				++end;
+			}
+		}
+
+		++end;
+	}
+
+	// last part
+	lines.push_back(text.substr(begin));
+
+	// lay out glyphs relative to the top left corner
+	items.clear();
+	height = 0;
+
+	for (auto &line : lines) {
+		renderer->layoutText(line, 0, height, color, items);
+		height += SPACING;
+	}
+}
+
+int TextBlock::render(int x, int y, int layer)
+{
+	renderer->addRenderItems(items, x, y, layer);
+
+	// so that it can be continued
+	return y + height;
+}
+
+int TextBlock::render(int x, int y, std::vector<RenderItem> &items)
+{
+	// append to a list instead, e.g. for a Panel
+	for (auto item : this->items) {
+		item.setX(item.getX() + x);
+		item.setY(item.getY() + y);
+		items.push_back(item);
+	}
+
+	return y + height;
+}
+
+Panel::Panel(Renderer *renderer) :
+	renderer(renderer),
+	dirty(true),
+	generation(0)
+{}
+
+void Panel::invalidate()
+{
+	dirty = true;
+}
+
+bool Panel::isStale()
+{
+	return dirty or not target() or
+	       generation != renderer->getTargetGeneration();
+}
+
+void Panel::compose(const TextureAccess &background, const std::vector<RenderItem> &items)
+{
+	if (not target()) {
+		int width, height;
+		renderer->getSize(&width, &height);
+
+		target = renderer->getTextureManager()->makeTarget(width, height);
+	}
+
+	/*
+	 * the background is translucent, copy it as is
+	 * so the panel keeps its alpha when blended later
+	 */
+	renderer->renderToTexture(
+		target,
+		{RenderItem(background, 0, 0, false, false, 0, true)},
+		SDL_BLENDMODE_NONE
+	);
+	renderer->renderToTexture(target, items, SDL_BLENDMODE_BLEND, 0, false);
+
+	dirty = false;
+	generation = renderer->getTargetGeneration();
+}
+
+void Panel::render(int layer)
+{
+	renderer->addRenderItem(target, 0, 0, false, false, layer, true);
+}
+
+Transition::Transition(Renderer *renderer, std::filesystem::path path) :
+	renderer(renderer),
+	path(path),
+	loaded(false),
+	frame_time(FRAMETIME),
+	duration(0),
+	from_x(0),
+	from_y(0),
+	from_opacity(255),
+	time(0)
+{}
+
+void Transition::load()
+{
+	loaded = true;
+
+	TextureManager *texture_manager = renderer->getTextureManager();
+	std::ifstream description(path / "transition.txt");
+
+	if (not description) {
+		loadNumbered();
+		return;
+	}
+
+	std::string type;
+
+	while (description >> type) {
+		if (type == "panel") {
+			std::string file;
+			description >> file;
+
+			panel = texture_manager->loadTexture(path / file);
+		} else if (type == "tween") {
+			description >> duration >> from_x >> from_y >> from_opacity;
+		} else if (type == "sheet") {
+			std::string file;
+			int columns = 0, count = 0;
+			int64_t ms = 0;
+			description >> file >> columns >> count >> ms;
+
+			// a broken sheet line would divide by zero below
+			if (not description or columns < 1 or count < 1 or ms < 1) {
+				SDL_Log("bad sheet in %s, using numbered frames", path.string().c_str());
+				frames.clear();
+				loadNumbered();
+				return;
+			}
+
+			frame_time = ms;
+
+			// frames left to right, then top to bottom
+			TextureAccess sheet = texture_manager->loadTexture(path / file);
+			int rows = (count + columns - 1) / columns;
+			int frame_w = sheet()->getWidth() / columns;
+			int frame_h = sheet()->getHeight() / rows;
+
+			for (int i = 0; i < count; ++i)
+				frames.push_back(texture_manager->makeRegion(
+					sheet,
+					{i % columns * frame_w, i / columns * frame_h, frame_w, frame_h}
+				));
+
+			duration = (count - 1) * frame_time;
+		}
+	}
+
+	if (not panel() and not frames.empty())
+		panel = frames.back();
+}
+
+void Transition::loadNumbered()
+{
+	// one full screen image per frame
+	TextureManager *texture_manager = renderer->getTextureManager();
+	std::ifstream max_frame(path / "max_frame.txt");
+	int count = 0;
+
+	max_frame >> count;
+
+	for (int i = 0; i < count; ++i)
+		frames.push_back(texture_manager->loadTexture(path / (std::to_string(i + 1) + ".png")));
+
+	if (not frames.empty()) {
+		panel = frames.back();
+		duration = (frames.size() - 1) * frame_time;
+	}
+}
+
+void Transition::update(bool open, uint64_t delta)
+{
+	if (open and not loaded)
+		load();
+
+	// closing is instant, the next open plays from the start
+	if (open)
+		time = std::min(time + delta, duration);
+	else
+		time = 0;
+}
+
+bool Transition::isOpen()
+{
+	return loaded and time >= duration;
+}
+
+void Transition::render(int layer)
+{
+	if (not frames.empty()) {
+		size_t frame = std::min<size_t>(time / frame_time, frames.size() - 1);
+		renderer->addRenderItem(frames[frame], 0, 0, false, false, layer, true);
+		return;
+	}
+
+	if (not panel())
+		return;
+
+	// ease out, fast at first then settling in place
+	float progress = duration ? static_cast<float>(time) / duration : 1;
+	float ease = 1 - (1 - progress) * (1 - progress);
+
+	RenderItem item(panel, from_x * (1 - ease), from_y * (1 - ease), false, false, layer, true);
+	item.setOpacity(from_opacity + (255 - from_opacity) * ease);
+
+	renderer->addRenderItem(item);
+}
+
+TextureAccess Transition::getPanel()
+{
+	return panel;
+}
+
 UIManager::UIManager(Manager *parent) :
 	parent(parent),
 	renderer(parent->getRenderer()),
@@ -24,12 +273,16 @@ UIManager::UIManager(Manager *parent) :
 	game_manager(parent->getGameManager()),
 	tick(0),
 	splash_deadline(10000), // time to leave splash on screen for
-	menu_deadline(0),
-	menu_counter(0),
-	quiz_deadline(0),
-	quiz_counter(0),
 	in_menu(false),
-	in_quiz(false)
+	in_quiz(false),
+	question_text(renderer),
+	answer_text(3, TextBlock(renderer)),
+	menu_panel(renderer),
+	quiz_panel(renderer),
+	menu_state{},
+	menu(renderer, "data/ui/menu"),
+	quiz(renderer, "data/ui/quiz"),
+	effects(renderer, 1024, 12, true)
 {
 	// prevent input before splash screen takes over
 	game_manager->setPaused(true);
@@ -37,37 +290,13 @@ UIManager::UIManager(Manager *parent) :
 	// load splash texture
 	splash = texture_manager->loadTexture("data/logo/splash.png");
 
-	// load menu and quiz animation frames
-	std::ifstream menu_frames_file("data/ui/menu/max_frame.txt");
-	int menu_frames;
-
-	menu_frames_file >> menu_frames;
-	menu.resize(menu_frames);
-
-	for (int i = 0; i < menu_frames; ++i) {
-		std::ostringstream buf;
-		buf << "data/ui/menu/" << i + 1 << ".png";
-		menu[i] = texture_manager->loadTexture(buf.str());
-	}
-
-	std::ifstream quiz_frames_file("data/ui/quiz/max_frame.txt");
-	int quiz_frames;
-
-	quiz_frames_file >> quiz_frames;
-	quiz.resize(quiz_frames);
-
-	for (int i = 0; i < quiz_frames; ++i) {
-		std::ostringstream buf;
-		buf << "data/ui/quiz/" << i + 1 << ".png";
-		quiz[i] = texture_manager->loadTexture(buf.str());
-	}
+	// menu and quiz transitions load when first opened
 
 	continue_btn = texture_manager->loadTexture("data/ui/button/continue_sel.png");
 	documentation_btn = texture_manager->loadTexture("data/ui/button/documentation_sel.png");
 	exit_btn = texture_manager->loadTexture("data/ui/button/exit_sel.png");
 	submit_btn = texture_manager->loadTexture("data/ui/button/submit_sel.png");
 
-	minimap = texture_manager->loadTexture("data/ui/minimap.png");
 	point = texture_manager->loadTexture("data/ui/point.png");
 }
 
@@ -78,6 +307,8 @@ void UIManager::displayQuiz(std::string question, std::vector<std::string> answe
 	this->answers = answers;
 	// just in case
 	this->answers.resize(3);
+
+	quiz_panel.invalidate();
 }
 
 void UIManager::endQuiz()
@@ -85,6 +316,17 @@ void UIManager::endQuiz()
 	in_quiz = false;
 }
 
+void UIManager::showResult(bool correct)
+{
+	int x = 265 + submit_btn()->getWidth() / 2;
+	int y = 225 + submit_btn()->getHeight() / 2;
+
+	if (correct)
+		effects.emit(x, y, 160, 160, 1.2, GREEN);
+	else
+		effects.emit(x, y, 64, 80, 0.6, RED);
+}
+
 void UIManager::operator()(uint64_t delta)
 {
 	tick += delta;
@@ -105,85 +347,140 @@ void UIManager::operator()(uint64_t delta)
 
 	if (input_handler->isPause(true)) in_menu = not in_menu;
 
+	menu.update(in_menu, delta);
+	quiz.update(in_quiz, delta);
+
 	if (in_menu) {
 		// for buttons
 		static int choice = 0;
 
-		if (menu_counter < menu.size() - 1) {
-			if (tick >= menu_deadline) {
-				menu_deadline = tick + FRAMETIME;
-				++menu_counter;
-			}
-
-			renderer->addRenderItem(menu[menu_counter], 0, 0, false, false, 10, true);
+		if (not menu.isOpen()) {
+			menu.render(10);
 
 			choice = 0;
+			menu_panel.invalidate();
 		} else {
-			// render final frame
-			renderer->addRenderItem(menu.back(), 0, 0, false, false, 10, true);
-			
-			// playtime
-			uint64_t hours, minutes;
-			std::ostringstream buf;
+			// buttons
+			if (input_handler->isPlayer(RIGHT, true) and choice < 2) {
+				++choice;
+				menu_panel.invalidate();
+			}
+
+			if (input_handler->isPlayer(LEFT, true) and choice > 0) {
+				--choice;
+				menu_panel.invalidate();
+			}
 
+			uint64_t hours, minutes;
 			getTime(game_manager->getPlaytime(), &hours, &minutes, nullptr);
 
-			buf << std::setfill('0') << std::setw(2)
-			    << hours << ':' << std::setw(2) << minutes;
+			int remaining = game_manager->getRemaining();
+			const std::list<std::string> &hints = game_manager->getHints();
 
-			TextureAccess playtime_text = texture_manager->makeText(buf.str());
-			renderer->addRenderItem(playtime_text, 213, 3, false, false, 11, true);
+			int player_x, player_y;
+			game_manager->getPlayer()->getMapPos(&player_x, &player_y);
 
-			// pickups remaining
-			TextureAccess remaining_text = texture_manager->makeText(std::to_string(game_manager->getRemaining()));
-			renderer->addRenderItem(remaining_text, 235, 18, false, false, 11, true);
+			MapManager *map_manager = game_manager->getMapManager();
+			TextureAccess minimap = map_manager->getMinimap();
 
-			// hints
-			std::list<std::string> hints = game_manager->getHints();
-			// starting height
-			int y = 46;
+			// game values the final frame shows
+			MENU_STATE state = {
+				hours, minutes, remaining, game_manager->getHintCount(),
+				player_x, player_y, minimap()
+			};
 
-			for (auto it : hints)
-				y = printText(it, 160, y, 26, 11) + 4;
+			if (state != menu_state) {
+				menu_state = state;
+				menu_panel.invalidate();
+			}
 
-			// minimap
-			// get player position
-			int player_x, player_y;
-			game_manager->getPlayer()->getMapPos(&player_x, &player_y);
+			if (menu_panel.isStale()) {
+				panel_items.clear();
 
-			/* 
-			 * scale minimap and pointer position
-			 * so that they align
-			 * dirty and hacky but time is nigh
-			 */
-			renderer->addRenderItem(minimap, -25, -3 * player_y + 119, false, false, 11, true);
-			renderer->addRenderItem(point, 3 * player_x - 29, 120, false, false, 11, true);
+				// playtime
+				std::ostringstream buf;
 
-			// buttons
-			if (input_handler->isPlayer(RIGHT, true) and choice < 2)
-				++choice;
+				buf << std::setfill('0') << std::setw(2)
+				    << hours << ':' << std::setw(2) << minutes;
 
-			if (input_handler->isPlayer(LEFT, true) and choice > 0)
-				--choice;
+				renderer->layoutText(buf.str(), 213, 3, BLACK, panel_items);
 
-			switch (choice) {
-			case 0:
-				renderer->addRenderItem(continue_btn, 156, 226, false, false, 11, true);
-				break;
+				// pickups remaining
+				renderer->layoutText(std::to_string(remaining), 235, 18, BLACK, panel_items);
 
-			case 1:
-				renderer->addRenderItem(documentation_btn, 209, 226, false, false, 11, true);
-				break;
+				// hints
+				// starting height
+				int y = 46;
 
-			case 2:
-				renderer->addRenderItem(exit_btn, 290, 226, false, false, 11, true);
-				break;
+				hint_text.resize(hints.size(), TextBlock(renderer));
+				auto block = hint_text.begin();
 
-			default:
-				choice = 0;
-				break;
+				for (auto &it : hints) {
+					block->set(it, 26);
+					y = block->render(160, y, panel_items) + 4;
+					++block;
+				}
+
+				/*
+				 * minimap, cropped to the left page
+				 * and scrolled to keep the player in the middle
+				 */
+				if (minimap()) {
+					static const SDL_Rect page = {0, 0, 150, 240};
+					int scale = map_manager->getMinimapScale();
+					int map_w = minimap()->getWidth();
+					int map_h = minimap()->getHeight();
+
+					// player in minimap pixels
+					int center_x = player_x * scale + scale / 2;
+					int center_y = player_y * scale + scale / 2;
+
+					SDL_Rect source = {
+						std::clamp(center_x - page.w / 2, 0, std::max(map_w - page.w, 0)),
+						std::clamp(center_y - page.h / 2, 0, std::max(map_h - page.h, 0)),
+						std::min(page.w, map_w),
+						std::min(page.h, map_h)
+					};
+
+					// smaller maps sit in the middle of the page
+					int map_x = page.x + (page.w - source.w) / 2;
+					int map_y = page.y + (page.h - source.h) / 2;
+
+					minimap_view = texture_manager->makeRegion(minimap, source);
+
+					panel_items.emplace_back(minimap_view, map_x, map_y, false, false, 11, true);
+					panel_items.emplace_back(
+						point,
+						map_x + center_x - source.x - point()->getWidth() / 2,
+						map_y + center_y - source.y - point()->getHeight() / 2,
+						false, false, 11, true
+					);
+				}
+
+				switch (choice) {
+				case 0:
+					panel_items.emplace_back(continue_btn, 156, 226, false, false, 11, true);
+					break;
+
+				case 1:
+					panel_items.emplace_back(documentation_btn, 209, 226, false, false, 11, true);
+					break;
+
+				case 2:
+					panel_items.emplace_back(exit_btn, 290, 226, false, false, 11, true);
+					break;
+
+				default:
+					choice = 0;
+					break;
+				}
+
+				menu_panel.compose(menu.getPanel(), panel_items);
 			}
 
+			// final frame with everything on it
+			menu_panel.render(10);
+
 			if (input_handler->isEnter(true))
 				switch (choice) {
 				case 0:
@@ -199,94 +496,93 @@ void UIManager::operator()(uint64_t delta)
 					break;
 				}
 		}
-	} else if (menu_counter > 0) {
-		if (tick >= menu_deadline) {
-			menu_deadline = tick + FRAMETIME;
-			--menu_counter;
-		}
-
-		renderer->addRenderItem(menu[menu_counter], 0, 0, false, false, 10, true);
 	}
 
 	if (in_quiz) {
 		// for buttons
 		static int choice = 1;
 
-		if (quiz_counter < quiz.size() - 1) {
-			if (tick >= quiz_deadline) {
-				quiz_deadline = tick + FRAMETIME;
-				++quiz_counter;
-			}
-
-			renderer->addRenderItem(quiz[quiz_counter], 0, 0, false, false, 8, true);
+		if (not quiz.isOpen()) {
+			quiz.render(8);
 
 			choice = 1;
+			quiz_panel.invalidate();
 		} else {
-			renderer->addRenderItem(quiz.back(), 0, 0, false, false, 8, true);
-
-			// question
-			printText(question, 10, 5, 24, 9);
-
 			// answers
 			static std::vector<bool> selected(3);
-			if (input_handler->isAnswer(1, true))
-				selected[0] = not selected[0];
-			if (input_handler->isAnswer(2, true))
-				selected[1] = not selected[1];
-			if (input_handler->isAnswer(3, true))
-				selected[2] = not selected[2];
-
-			COLOR color;
-			TextureAccess digit;
-
-			if (selected[0])
-				color = GREEN;
-			else
-				color = BLACK;
-
-			digit = texture_manager->makeText("1.", color);
-			renderer->addRenderItem(digit, 160, 5, false, false, 9, true);
-			printText(answers[0], 175, 5, 24, 9, color);
-
-			if (selected[1])
-				color = GREEN;
-			else
-				color = BLACK;
-
-			digit = texture_manager->makeText("2.", color);
-			renderer->addRenderItem(digit, 160, 80, false, false, 9, true);
-			printText(answers[1], 175, 80, 24, 9, color);
-
-			if (selected[2])
-				color = GREEN;
-			else
-				color = BLACK;
-
-			digit = texture_manager->makeText("3.", color);
-			renderer->addRenderItem(digit, 160, 155, false, false, 9, true);
-			printText(answers[2], 175, 155, 24, 9, color);
+
+			for (int i = 0; i < 3; ++i)
+				if (input_handler->isAnswer(i + 1, true)) {
+					selected[i] = not selected[i];
+					quiz_panel.invalidate();
+				}
 
 			// buttons
-			if (input_handler->isPlayer(RIGHT, true) and choice < 1)
+			if (input_handler->isPlayer(RIGHT, true) and choice < 1) {
 				++choice;
+				quiz_panel.invalidate();
+			}
 
-			if (input_handler->isPlayer(LEFT, true) and choice > 0)
+			if (input_handler->isPlayer(LEFT, true) and choice > 0) {
 				--choice;
+				quiz_panel.invalidate();
+			}
+
+			if (quiz_panel.isStale()) {
+				panel_items.clear();
+
+				// question
+				question_text.set(question, 24);
+				question_text.render(10, 5, panel_items);
+
+				COLOR color;
+
+				if (selected[0])
+					color = GREEN;
+				else
+					color = BLACK;
 
-			switch (choice) {
-			case 0:
-				renderer->addRenderItem(documentation_btn, 172, 225, false, false, 9, true);
-				break;
+				renderer->layoutText("1.", 160, 5, color, panel_items);
+				answer_text[0].set(answers[0], 24, color);
+				answer_text[0].render(175, 5, panel_items);
 
-			case 1:
-				renderer->addRenderItem(submit_btn, 265, 225, false, false, 9, true);
-				break;
+				if (selected[1])
+					color = GREEN;
+				else
+					color = BLACK;
 
-			default:
-				choice = 1;
-				break;
+				renderer->layoutText("2.", 160, 80, color, panel_items);
+				answer_text[1].set(answers[1], 24, color);
+				answer_text[1].render(175, 80, panel_items);
+
+				if (selected[2])
+					color = GREEN;
+				else
+					color = BLACK;
+
+				renderer->layoutText("3.", 160, 155, color, panel_items);
+				answer_text[2].set(answers[2], 24, color);
+				answer_text[2].render(175, 155, panel_items);
+
+				switch (choice) {
+				case 0:
+					panel_items.emplace_back(documentation_btn, 172, 225, false, false, 9, true);
+					break;
+
+				case 1:
+					panel_items.emplace_back(submit_btn, 265, 225, false, false, 9, true);
+					break;
+
+				default:
+					choice = 1;
+					break;
+				}
+
+				quiz_panel.compose(quiz.getPanel(), panel_items);
 			}
 
+			quiz_panel.render(8);
+
 			if (input_handler->isEnter(true))
 				switch (choice) {
 				case 0:
@@ -296,58 +592,16 @@ void UIManager::operator()(uint64_t delta)
 				case 1:
 					game_manager->getQuizManager()->provideAnswer(selected);
 					selected[0] = selected[1] = selected[2] = false;
+					quiz_panel.invalidate();
 					break;
 				}
 		}
-	} else if (quiz_counter > 0) {
-		if (tick >= quiz_deadline) {
-			quiz_deadline = tick + FRAMETIME;
-			--quiz_counter;
-		}
-
-		renderer->addRenderItem(quiz[quiz_counter], 0, 0, false, false, 8, true);
-	}
-
-	game_manager->setPaused(in_menu or in_quiz);
-}
-
-int UIManager::printText(std::string text, int x, int y, int max_char, int layer, COLOR color)
-{
-	/*
-	 * function to print text with wrapping
-	 * use ; to force newline
-	 */
-
-	// spacing between lines
-	static const int SPACING = 12;
-	unsigned int begin = 0;
-	unsigned int end = 1;
-
-	while (end < text.size()) {
-		if (text[end] == ';' or end - begin + 1 >= max_char) {
-			TextureAccess text_part = texture_manager->makeText(text.substr(begin, end - begin), color);
-			renderer->addRenderItem(text_part, x, y, false, false, layer, true);
-
-			begin = end;
-			y += SPACING;
-
-			if (text[begin] == ';') {
-				++begin;
-				++end;
-			}
-		}
-
-		++end;
 	}
 
-	// print last part
-	TextureAccess text_part = texture_manager->makeText(text.substr(begin), color);
-	renderer->addRenderItem(text_part, x, y, false, false, layer, true);
+	effects.update(delta);
+	effects.render();
 
-	y += SPACING;
-
-	// so that it can be continued
-	return y;
+	game_manager->setPaused(in_menu or in_quiz);
 }
 
 void UIManager::openDocumentation()
@@ -52,3 +52,15 @@ void getTime(uint64_t time, uint64_t *hours, uint64_t *minutes, uint64_t *second
 	if (seconds)
 		*seconds = s;
 };
+
+uint64_t hashBytes(const void *data, size_t size, uint64_t hash)
+{
+	auto *bytes = static_cast<const uint8_t *>(data);
+
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3;
+	}
+
+	return hash;
+}
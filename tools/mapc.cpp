@@ -0,0 +1,256 @@
+#include "mapformat.h"
+#include "utilities.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if _WIN32
+#include <ciso646>
+#endif
+
+/*
+ * compiles text maps into the binary format of mapformat.h
+ * usage: ooq_mapc [-o directory] data/map/poli.txt ...
+ * every map is written to the same relative path under directory,
+ * or next to its source without -o, with MAP_EXTENSION
+ * paths are kept as written, so run it from the game directory
+ */
+
+struct TILE {
+	int x, y;
+	int layer;
+	uint32_t entry;
+	bool collision;
+};
+
+static void align(std::string &out, size_t alignment)
+{
+	out.resize((out.size() + alignment - 1) / alignment * alignment, '\0');
+}
+
+static bool compile(std::filesystem::path source, const std::filesystem::path &output)
+{
+	std::ifstream file(source, std::ios::binary);
+
+	if (not file) {
+		std::cerr << source.string() << ": cannot open\n";
+		return false;
+	}
+
+	// same bytes MapManager hashes for the minimap cache
+	std::string content(
+		(std::istreambuf_iterator<char>(file)),
+		std::istreambuf_iterator<char>()
+	);
+	std::istringstream data(content);
+
+	MAP_HEADER header = {};
+	header.magic = MAP_MAGIC;
+	header.version = MAP_VERSION;
+	header.source_hash = hashBytes(content.data(), content.size());
+
+	data >> header.spawn_x >> header.spawn_y;
+
+	std::vector<std::pair<std::string, MAP_KIND>> entries;
+	std::map<std::pair<std::string, MAP_KIND>, uint32_t> ids;
+	std::vector<TILE> tiles;
+	std::vector<MAP_OBJECT> objects;
+
+	auto getEntry = [&](const std::filesystem::path &path, MAP_KIND kind) {
+		auto key = std::make_pair(path.string(), kind);
+		auto found = ids.find(key);
+
+		if (found != ids.end())
+			return found->second;
+
+		entries.push_back(key);
+		return ids[key] = entries.size() - 1;
+	};
+
+	int pos_x, pos_y;
+	std::filesystem::path path;
+
+	// mirrors the text loader in MapManager::loadMap
+	while (data >> pos_x >> pos_y >> path) {
+		if (pos_x < 0 or pos_y < 0) {
+			std::cerr << source.string() << ": negative position " << pos_x << ' ' << pos_y << '\n';
+			return false;
+		}
+
+		// every line grows the map, objects included
+		header.width = std::max(header.width, pos_x + 1);
+		header.height = std::max(header.height, pos_y + 1);
+
+		if (path.extension() == ".png" or path.extension() == ".anim") {
+			// some maps use other non zero values for solid
+			int coll, layer;
+			data >> coll >> layer;
+
+			if (layer < 0 or layer >= MAP_LAYERS) {
+				std::cerr << source.string() << ": bad layer " << layer << " for " << path.string() << '\n';
+				return false;
+			}
+
+			MAP_KIND kind = path.extension() == ".png" ? MAP_KIND_TILE : MAP_KIND_ANIMATION;
+			tiles.push_back({pos_x, pos_y, layer, getEntry(path, kind), coll != 0});
+		} else if (path.extension() == ".txt") {
+			objects.push_back({pos_x, pos_y, getEntry(path, MAP_KIND_OBJECT)});
+		}
+	}
+
+	size_t cells = static_cast<size_t>(header.width) * header.height;
+
+	/*
+	 * later lines overwrite earlier ones, like in the game
+	 * cells no tile line mentions stay solid, as resizeMapStorage leaves them
+	 */
+	std::vector<uint16_t> layers(MAP_LAYERS * cells, 0);
+	std::vector<uint8_t> collision((cells + 7) / 8, 0xFF);
+
+	if (entries.size() >= UINT16_MAX) {
+		std::cerr << source.string() << ": too many distinct paths\n";
+		return false;
+	}
+
+	for (auto &tile : tiles) {
+		size_t cell = static_cast<size_t>(tile.x) * header.height + tile.y;
+		layers[tile.layer * cells + cell] = tile.entry + 1;
+
+		if (tile.collision)
+			collision[cell / 8] |= 1 << (cell % 8);
+		else
+			collision[cell / 8] &= ~(1 << (cell % 8));
+	}
+
+	// tiles of a map mostly share a few directories, store each once
+	std::vector<std::string> directories;
+	std::map<std::string, uint16_t> directory_ids;
+	std::vector<MAP_ENTRY> table;
+
+	for (auto &entry : entries) {
+		size_t slash = entry.first.rfind('/');
+		size_t split = slash == std::string::npos ? 0 : slash + 1;
+		std::string directory = entry.first.substr(0, split);
+
+		if (entry.first.size() - split > UINT8_MAX or directory.size() > UINT16_MAX) {
+			std::cerr << source.string() << ": path too long " << entry.first << '\n';
+			return false;
+		}
+
+		auto found = directory_ids.find(directory);
+
+		if (found == directory_ids.end()) {
+			if (directories.size() > UINT16_MAX) {
+				std::cerr << source.string() << ": too many directories\n";
+				return false;
+			}
+
+			directories.push_back(directory);
+			found = directory_ids.emplace(directory, directories.size() - 1).first;
+		}
+
+		table.push_back({
+			0,
+			found->second,
+			static_cast<uint8_t>(entry.first.size() - split),
+			static_cast<uint8_t>(entry.second)
+		});
+	}
+
+	// lay the file out behind the header
+	std::string out(sizeof(MAP_HEADER), '\0');
+
+	header.directory_count = directories.size();
+	header.directory_offset = out.size();
+	out.resize(out.size() + directories.size() * sizeof(MAP_DIRECTORY));
+
+	header.entry_count = entries.size();
+	header.entry_offset = out.size();
+	out.resize(out.size() + entries.size() * sizeof(MAP_ENTRY));
+
+	std::vector<MAP_DIRECTORY> directory_table;
+
+	for (auto &directory : directories) {
+		directory_table.push_back({
+			static_cast<uint32_t>(out.size()),
+			static_cast<uint16_t>(directory.size()),
+			0
+		});
+		out += directory;
+	}
+
+	for (size_t i = 0; i < entries.size(); ++i) {
+		table[i].name_offset = out.size();
+		out += entries[i].first.substr(entries[i].first.size() - table[i].name_size);
+	}
+
+	std::copy_n(reinterpret_cast<const char *>(directory_table.data()), directory_table.size() * sizeof(MAP_DIRECTORY), out.begin() + header.directory_offset);
+	std::copy_n(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(MAP_ENTRY), out.begin() + header.entry_offset);
+
+	align(out, 4);
+	header.layer_offset = out.size();
+	out.append(reinterpret_cast<const char *>(layers.data()), layers.size() * sizeof(uint16_t));
+
+	header.collision_offset = out.size();
+	out.append(reinterpret_cast<const char *>(collision.data()), collision.size());
+
+	align(out, 4);
+	header.object_count = objects.size();
+	header.object_offset = out.size();
+	out.append(reinterpret_cast<const char *>(objects.data()), objects.size() * sizeof(MAP_OBJECT));
+
+	std::copy_n(reinterpret_cast<const char *>(&header), sizeof(header), out.begin());
+
+	std::filesystem::path target = output / source;
+	target.replace_extension(MAP_EXTENSION);
+
+	std::error_code error;
+	std::filesystem::create_directories(target.parent_path(), error);
+
+	std::ofstream compiled(target, std::ios::binary);
+	compiled.write(out.data(), out.size());
+
+	if (not compiled) {
+		std::cerr << target.string() << ": cannot write\n";
+		return false;
+	}
+
+	std::cout << source.string() << " -> " << target.string() << ": "
+		  << header.width << 'x' << header.height << ", "
+		  << tiles.size() << " tiles, "
+		  << entries.size() << " paths in " << directories.size() << " directories, "
+		  << objects.size() << " objects, "
+		  << content.size() << " -> " << out.size() << " bytes\n";
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	std::filesystem::path output;
+	int first = 1;
+
+	if (argc > 2 and std::string(argv[1]) == "-o") {
+		output = argv[2];
+		first = 3;
+	}
+
+	if (argc <= first) {
+		std::cerr << "usage: " << argv[0] << " [-o directory] map.txt...\n";
+		return 1;
+	}
+
+	bool ok = true;
+
+	for (int i = first; i < argc; ++i)
+		ok = compile(argv[i], output) and ok;
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+#include "packformat.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if _WIN32
+#include <ciso646>
+#endif
+
+/*
+ * packs game files into one archive, see packformat.h
+ * usage: ooq_pack assets.pack data...
+ * names are kept relative to the working directory
+ * so run it from the game directory
+ */
+
+// read by the system, not by the game
+static bool isSkipped(const std::filesystem::path &path)
+{
+	auto extension = path.extension();
+	return extension == ".pdf" or extension == ".md" or extension == ".map";
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 3) {
+		std::cerr << "usage: " << argv[0] << " output.pack directory...\n";
+		return 1;
+	}
+
+	std::vector<std::string> names;
+
+	for (int i = 2; i < argc; ++i)
+		for (auto &entry : std::filesystem::recursive_directory_iterator(argv[i]))
+			if (entry.is_regular_file() and not isSkipped(entry.path()))
+				names.push_back(entry.path().lexically_normal().generic_string());
+
+	// lookups binary search this order
+	std::sort(names.begin(), names.end());
+	names.erase(std::unique(names.begin(), names.end()), names.end());
+
+	PACK_HEADER header;
+	header.magic = PACK_MAGIC;
+	header.version = PACK_VERSION;
+	header.entry_count = names.size();
+	header.entry_offset = sizeof(header);
+
+	std::vector<PACK_ENTRY> entries(names.size());
+	uint64_t offset = header.entry_offset + entries.size() * sizeof(PACK_ENTRY);
+
+	for (size_t i = 0; i < names.size(); ++i) {
+		entries[i].name_offset = offset;
+		entries[i].name_size = names[i].size();
+		offset += names[i].size();
+	}
+
+	for (size_t i = 0; i < names.size(); ++i) {
+		offset = (offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+		entries[i].offset = offset;
+		entries[i].size = std::filesystem::file_size(names[i]);
+		entries[i].mtime = std::filesystem::last_write_time(names[i]).time_since_epoch().count();
+		offset += entries[i].size;
+	}
+
+	std::ofstream out(argv[1], std::ios::binary);
+
+	out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(PACK_ENTRY));
+
+	for (auto &name : names)
+		out.write(name.data(), name.size());
+
+	std::vector<char> buffer;
+
+	for (size_t i = 0; i < names.size(); ++i) {
+		// padding up to the aligned start
+		static const char zeros[PACK_ALIGNMENT] = {};
+		out.write(zeros, entries[i].offset - out.tellp());
+
+		std::ifstream file(names[i], std::ios::binary);
+		buffer.resize(entries[i].size);
+		file.read(buffer.data(), buffer.size());
+
+		if (not file) {
+			std::cerr << names[i] << ": cannot read\n";
+			return 1;
+		}
+
+		out.write(buffer.data(), buffer.size());
+	}
+
+	if (not out) {
+		std::cerr << argv[1] << ": cannot write\n";
+		return 1;
+	}
+
+	std::cout << argv[1] << ": " << names.size() << " files, " << offset << " bytes\n";
+	return 0;
+}